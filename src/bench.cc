@@ -0,0 +1,314 @@
+/*******************************************************
+                          bench.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "cache.h"
+#include "sim.h"
+#include "gen.h"
+
+/*results are printed as one csv row per measurement so that runs of
+  different simulator versions can be diffed and plotted: `version` only
+  changes with simulated results, `revision` with every source change*/
+#ifndef SMP_GIT_REV
+#define SMP_GIT_REV "unknown"
+#endif
+
+static double minTime = 0.2;      /*seconds of timed work per measurement*/
+static volatile ulong sink;      /*keeps lookups from being optimized away*/
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static ulong rng = 0x9E3779B97F4A7C15UL;
+static ulong nextRand()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static void report(const char *kind, const char *name, long proto, ulong procs,
+                   ulong size, ulong assoc, ulong blk, double ops, double secs)
+{
+    printf("%s,%s,%s,%s,%ld,%lu,%lu,%lu,%lu,%.0f,%.6f,%.0f\n", SMP_CACHE_VERSION, SMP_GIT_REV,
+           kind, name, proto, procs, size, assoc, blk, ops, secs, ops / secs);
+    fflush(stdout);
+}
+
+/*addresses spread over twice the cache capacity: about half of them hit*/
+static void makeAddrs(vector<ulong> &addrs, ulong size, ulong blk)
+{
+    for(ulong i = 0; i < addrs.size(); i++) {
+        addrs[i] = (nextRand() % (2 * size / blk)) * blk;
+    }
+}
+
+static void warmCache(Cache *c, const vector<ulong> &addrs)
+{
+    for(ulong i = 0; i < addrs.size(); i++) {
+        c->currentCycle++;
+        c->fillLine(addrs[i])->setFlags(STATE_SHARED);
+    }
+}
+
+static void benchFindLine(ulong size, ulong assoc, ulong blk)
+{
+    Cache c(size, assoc, blk);
+    vector<ulong> addrs(4096);
+    makeAddrs(addrs, size, blk);
+    warmCache(&c, addrs);
+
+    double ops = 0, secs = 0;
+    ulong hits = 0;
+    while(secs < minTime) {
+        double t0 = now();
+        for(ulong i = 0; i < addrs.size(); i++) {
+            hits += (c.findLine(addrs[i]) != NULL);
+        }
+        secs += now() - t0;
+        ops += addrs.size();
+    }
+    sink = hits;
+    report("micro", "findLine", -1, 1, size, assoc, blk, ops, secs);
+}
+
+static void benchGetLRU(ulong size, ulong assoc, ulong blk)
+{
+    Cache c(size, assoc, blk);
+    vector<ulong> addrs(4096);
+    makeAddrs(addrs, size, blk);
+    warmCache(&c, addrs);
+
+    double ops = 0, secs = 0;
+    ulong acc = 0;
+    while(secs < minTime) {
+        double t0 = now();
+        for(ulong i = 0; i < addrs.size(); i++) {
+            acc += c.getLRU(addrs[i])->getSeq();
+        }
+        secs += now() - t0;
+        ops += addrs.size();
+    }
+    sink = acc;
+    report("micro", "getLRU", -1, 1, size, assoc, blk, ops, secs);
+}
+
+static void benchFillLine(ulong size, ulong assoc, ulong blk)
+{
+    Cache c(size, assoc, blk);
+    vector<ulong> addrs(4096);
+    makeAddrs(addrs, size, blk);
+
+    double ops = 0, secs = 0;
+    while(secs < minTime) {
+        double t0 = now();
+        for(ulong i = 0; i < addrs.size(); i++) {
+            c.currentCycle++;
+            c.fillLine(addrs[i])->setFlags(STATE_SHARED);
+        }
+        secs += now() - t0;
+        ops += addrs.size();
+    }
+    report("micro", "fillLine", -1, 1, size, assoc, blk, ops, secs);
+}
+
+static void benchAccess(ulong proto, ulong size, ulong assoc, ulong blk)
+{
+    Cache *c = createCache(proto, size, assoc, blk);
+    vector<ulong> addrs(4096);
+    vector<uchar> ops_(addrs.size());
+    makeAddrs(addrs, size, blk);
+    for(ulong i = 0; i < ops_.size(); i++) {
+        ops_[i] = (nextRand() % 10 < 3) ? 'w' : 'r';
+    }
+
+    double ops = 0, secs = 0;
+    ulong acc = 0;
+    while(secs < minTime) {
+        double t0 = now();
+        for(ulong i = 0; i < addrs.size(); i++) {
+            acc += c->Access(addrs[i], ops_[i]);
+        }
+        secs += now() - t0;
+        ops += addrs.size();
+    }
+    sink = acc;
+    report("micro", "Access", proto, 1, size, assoc, blk, ops, secs);
+    delete c;
+}
+
+static void benchSnoop(ulong proto, ulong size, ulong assoc, ulong blk)
+{
+    Cache *c = createCache(proto, size, assoc, blk);
+    vector<ulong> addrs(4096);
+    vector<busRequestType> reqs(addrs.size());
+    makeAddrs(addrs, size, blk);
+    for(ulong i = 0; i < reqs.size(); i++) {
+        ulong r = nextRand() % 10;
+        reqs[i] = (r < 8) ? BUS_REQ_READ : (r == 8) ? BUS_REQ_READX : BUS_REQ_UPGRADE;
+    }
+
+    double ops = 0, secs = 0;
+    ulong acc = 0;
+    while(secs < minTime) {
+        /*invalidating snoops empty the cache, refill it outside the timed region*/
+        for(ulong i = 0; i < addrs.size(); i++) {
+            c->Access(addrs[i], (i & 1) ? 'w' : 'r');
+        }
+        double t0 = now();
+        for(ulong i = 0; i < addrs.size(); i++) {
+            bool present = false;
+            acc += c->snoop(addrs[i], reqs[i], present);
+        }
+        secs += now() - t0;
+        ops += addrs.size();
+    }
+    sink = acc;
+    report("micro", "snoop", proto, 1, size, assoc, blk, ops, secs);
+    delete c;
+}
+
+static void benchGenerator(int pattern, ulong procs, ulong blk)
+{
+    TraceGenerator gen;
+    vector<TraceRecord> batch(4096);
+    string spec = string(genPatternName[pattern]) + ",records=1g";
+    gen.configure(spec.c_str(), procs, blk);
+
+    double ops = 0, secs = 0;
+    while(secs < minTime) {
+        double t0 = now();
+        ops += gen.fill(&batch[0], batch.size());
+        secs += now() - t0;
+    }
+    sink = batch[0].addr;
+    report("micro", (string("gen:") + genPatternName[pattern]).c_str(), -1, procs, 0, 0, blk, ops, secs);
+}
+
+static void benchTrace(const char *name, const vector<TraceRecord> &trace, ulong proto,
+                       ulong procs, ulong size, ulong assoc, ulong blk)
+{
+    SimConfig config;
+    config.cache_size = size;
+    config.cache_assoc = assoc;
+    config.blk_size = blk;
+    config.num_processors = procs;
+    config.protocol = proto;
+    config.prefetch = PREFETCH_NONE;
+    config.prefetchDegree = 1;
+    config.trace = name;
+    Simulator sim;
+    sim.configure(config);
+
+    double ops = 0, secs = 0;
+    while(secs < minTime) {
+        sim.reset();
+        double t0 = now();
+        sim.step(&trace[0], trace.size());
+        secs += now() - t0;
+        ops += trace.size();
+    }
+    report("trace", name, proto, procs, size, assoc, blk, ops, secs);
+}
+
+static bool loadTrace(const char *fname, vector<TraceRecord> &trace, ulong &procs)
+{
+    FILE *pFile = fopen(fname, "r");
+    if(pFile == 0) {
+        return false;
+    }
+    TraceRecord rec;
+    char op;
+    procs = 0;
+    while(fscanf(pFile, "%lu %c %lx", &rec.proc, &op, &rec.addr) == 3) {
+        rec.op = op;
+        trace.push_back(rec);
+        if(rec.proc >= procs) procs = rec.proc + 1;
+    }
+    fclose(pFile);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    vector<const char *> traceFiles;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--quick") == 0) {
+            minTime = 0.02;
+        } else if(strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTime = atof(argv[++i]);
+        } else if(argv[i][0] == '-') {
+            printf("input format: ");
+            printf("./smp_bench [--quick] [--min-time <seconds>] [trace_file ...] \n");
+            exit(0);
+        } else {
+            traceFiles.push_back(argv[i]);
+        }
+    }
+
+    const ulong size = 8192, blk = 64;
+    const ulong assocs[] = {1, 4, 8, 16};
+    const ulong procCounts[] = {2, 4, 8, 16};
+
+    printf("version,revision,kind,name,protocol,procs,size,assoc,blk,ops,seconds,ops_per_sec\n");
+
+    for(ulong a = 0; a < 4; a++) {
+        benchFindLine(size, assocs[a], blk);
+        benchGetLRU(size, assocs[a], blk);
+        benchFillLine(size, assocs[a], blk);
+    }
+    for(ulong p = 0; p < numProtocols; p++) {
+        benchAccess(p, size, 8, blk);
+        benchSnoop(p, size, 8, blk);
+    }
+    for(int g = 0; g < GEN_MAX; g++) {
+        benchGenerator(g, 4, blk);
+    }
+
+    for(ulong f = 0; f < traceFiles.size(); f++) {
+        vector<TraceRecord> trace;
+        ulong procs;
+        if(!loadTrace(traceFiles[f], trace, procs) || trace.empty()) {
+            fprintf(stderr, "Trace file problem: %s\n", traceFiles[f]);
+            continue;
+        }
+        const char *name = strrchr(traceFiles[f], '/');
+        name = name ? name + 1 : traceFiles[f];
+        for(ulong a = 0; a < 4; a++) {
+            for(ulong p = 0; p < numProtocols; p++) {
+                benchTrace(name, trace, p, procs, size, assocs[a], blk);
+            }
+        }
+    }
+
+    /*synthetic workloads are generated up front so only the simulator is timed*/
+    for(ulong n = 0; n < 4; n++) {
+        for(int g = 0; g < GEN_MAX; g++) {
+            TraceGenerator gen;
+            string spec = string(genPatternName[g]) + ",records=100000";
+            gen.configure(spec.c_str(), procCounts[n], blk);
+            vector<TraceRecord> trace(100000);
+            trace.resize(gen.fill(&trace[0], trace.size()));
+            string name = "gen:" + string(genPatternName[g]);
+            for(ulong a = 0; a < 4; a++) {
+                for(ulong p = 0; p < numProtocols; p++) {
+                    benchTrace(name.c_str(), trace, p, procCounts[n], size, assocs[a], blk);
+                }
+            }
+        }
+    }
+    return 0;
+}
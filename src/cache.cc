@@ -3,15 +3,16 @@
 ********************************************************/
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <assert.h>
 #include "cache.h"
+#include "profile.h"
+#include "prefetch.h"
 using namespace std;
 
 Cache::Cache(int s,int a,int b )
 {
-   ulong i, j;
-   reads = readMisses = writes = 0; 
-   writeMisses = writeBacks = currentCycle = 0;
+   ulong i;
 
    size       = (ulong)(s);
    lineSize   = (ulong)(b);
@@ -20,7 +21,32 @@ Cache::Cache(int s,int a,int b )
    numLines   = (ulong)(s/b);
    log2Sets   = (ulong)(log2(sets));   
    log2Blk    = (ulong)(log2(b));   
-  
+   prefetcher = NULL;
+
+   tagMask =0;
+   for(i=0;i<log2Sets;i++)
+   {
+      tagMask <<= 1;
+      tagMask |= 1;
+   }
+   
+   /**create a two dimentional cache, sized as cache[sets][assoc]**/ 
+   cache = new cacheLine*[sets];
+   for(i=0; i<sets; i++)
+   {
+      cache[i] = new cacheLine[assoc];
+   }      
+
+   Cache::reset();
+}
+
+/*back to the just-constructed state without touching the allocation*/
+void Cache::reset()
+{
+   ulong i, j;
+   reads = readMisses = writes = 0; 
+   writeMisses = writeBacks = currentCycle = 0;
+
    //*******************//
    //initialize your counters here//
    //*******************//
@@ -32,25 +58,39 @@ Cache::Cache(int s,int a,int b )
     ct_flushes = 0;
     ct_BusRdX = 0;
     ct_BusUpgr = 0;
+    ct_prefetches = 0;
+    ct_prefetch_useful = 0;
+    ct_prefetch_unused = 0;
+    ct_prefetch_invalidated = 0;
+    ct_prefetch_upgrades = 0;
+    ct_prefetch_downgrades = 0;
+    ct_atomics = 0;
+    ct_fences = 0;
+    ct_sc_success = 0;
+    ct_sc_failures = 0;
+    linkValid = false;
+    linkBlock = 0;
 
-   tagMask =0;
-   for(i=0;i<log2Sets;i++)
-   {
-      tagMask <<= 1;
-      tagMask |= 1;
-   }
-   
-   /**create a two dimentional cache, sized as cache[sets][assoc]**/ 
-   cache = new cacheLine*[sets];
    for(i=0; i<sets; i++)
    {
-      cache[i] = new cacheLine[assoc];
       for(j=0; j<assoc; j++) 
       {
          cache[i][j].invalidate();
       }
-   }      
-   
+   }
+   if(prefetcher != NULL) {
+      prefetcher->reset();
+   }
+}
+
+Cache::~Cache()
+{
+   for(ulong i=0; i<sets; i++)
+   {
+      delete [] cache[i];
+   }
+   delete [] cache;
+   delete prefetcher;
 }
 
 /**you might add other parameters to Access()
@@ -62,8 +102,9 @@ busRequestType Cache::Access(ulong addr,uchar op)
    currentCycle++;/*per cache global counter to maintain LRU order 
                     among cache ways, updated on every cache access*/
 
-   if (op == 'w') writes++;
+   if (isWriteOp(op)) writes++;
    else reads++;
+   if (op == 'a') ct_atomics++;
    return busReq;
 }
 
@@ -76,6 +117,7 @@ busRequestType Cache::snoop(ulong addr, busRequestType busReq, bool &isLinePrese
 /*look up line*/
 cacheLine * Cache::findLine(ulong addr)
 {
+   PROF_SCOPE(PROF_FIND_LINE);
    ulong i, j, tag, pos;
    
    pos = assoc;
@@ -144,44 +186,132 @@ cacheLine *Cache::findLineToReplace(ulong addr)
 /*allocate a new line*/
 cacheLine *Cache::fillLine(ulong addr)
 {
+   PROF_SCOPE(PROF_FILL_LINE);
 
    ulong tag;
   
    cacheLine *victim = findLineToReplace(addr);
    assert(victim != 0);
    
-   if(victim->getFlags() == STATE_MODIFIED) {
+   if(victim->getFlags() == STATE_MODIFIED || victim->getFlags() == STATE_SHARED_MODIFIED) {
        ct_memory_transactions++;
       writeBack(addr);
    }
+   if(victim->isValid() && victim->isPrefetched()) {
+      ct_prefetch_unused++;
+   }
+   // evicting the linked block loses the reservation even if it comes back
+   if(linkValid && victim->isValid() && victim->getTag() == linkBlock) {
+      linkValid = false;
+   }
 
    tag = calcTag(addr);   
    victim->setTag(tag);
    victim->setFlags(STATE_INVALID);
+   victim->setPrefetched(false);
    /**note that this cache line has been already 
       upgraded to MRU in the previous function (findLineToReplace)**/
 
    return victim;
 }
 
-void Cache::printStats()
+/*allocate a line for a prefetch, it arrives in Shared until the bus says otherwise*/
+cacheLine *Cache::prefetchFill(ulong addr)
+{
+   cacheLine *line = fillLine(addr);
+   line->setFlags(STATE_SHARED);
+   line->setPrefetched(true);
+   ct_prefetches++;
+   return line;
+}
+
+void Cache::printStats(FILE *out)
 {
    /****print out the rest of statistics here.****/
    /****follow the ouput file format**************/
-    cout << "01. number of reads: " << reads << endl;
-    cout << "02. number of read misses: " << readMisses << endl;
-    cout << "03. number of writes: " << writes << endl;
-    cout << "04. number of write misses: " << writeMisses << endl;
+    fprintf(out, "01. number of reads: %lu\n", reads);
+    fprintf(out, "02. number of read misses: %lu\n", readMisses);
+    fprintf(out, "03. number of writes: %lu\n", writes);
+    fprintf(out, "04. number of write misses: %lu\n", writeMisses);
     miss_rate = ((float)(readMisses + writeMisses)) / ((float)(reads + writes)) * 100;
-    cout << "05. total miss rate: " << std::setprecision(3) << miss_rate << "%" << endl;
-    cout << "06. number of writebacks: " << writeBacks << endl;
-    cout << "07. number of cache-to-cache transfers: " << ct_cache_to_cache_transfers << endl;
-    cout << "08. number of memory transactions: " << ct_memory_transactions << endl;
-    cout << "09. number of interventions: " << ct_interventions << endl;
-    cout << "10. number of invalidations: " << ct_invalidations << endl;
-    cout << "11. number of flushes: " << ct_flushes << endl;
-    cout << "12. number of BusRdX: " << ct_BusRdX << endl;
-    cout << "13. number of BusUpgr: " << ct_BusUpgr << endl;
+    fprintf(out, "05. total miss rate: %.3g%%\n", miss_rate);
+    fprintf(out, "06. number of writebacks: %lu\n", writeBacks);
+    fprintf(out, "07. number of cache-to-cache transfers: %lu\n", ct_cache_to_cache_transfers);
+    fprintf(out, "08. number of memory transactions: %lu\n", ct_memory_transactions);
+    fprintf(out, "09. number of interventions: %lu\n", ct_interventions);
+    fprintf(out, "10. number of invalidations: %lu\n", ct_invalidations);
+    fprintf(out, "11. number of flushes: %lu\n", ct_flushes);
+    fprintf(out, "12. number of BusRdX: %lu\n", ct_BusRdX);
+    fprintf(out, "13. number of BusUpgr: %lu\n", ct_BusUpgr);
+}
+
+void Cache::getCounters(counterList &counters)
+{
+    counters.push_back(make_pair("reads", reads));
+    counters.push_back(make_pair("read_misses", readMisses));
+    counters.push_back(make_pair("writes", writes));
+    counters.push_back(make_pair("write_misses", writeMisses));
+    counters.push_back(make_pair("writebacks", writeBacks));
+    counters.push_back(make_pair("cache_to_cache_transfers", ct_cache_to_cache_transfers));
+    counters.push_back(make_pair("memory_transactions", ct_memory_transactions));
+    counters.push_back(make_pair("interventions", ct_interventions));
+    counters.push_back(make_pair("invalidations", ct_invalidations));
+    counters.push_back(make_pair("flushes", ct_flushes));
+    counters.push_back(make_pair("busrdx", ct_BusRdX));
+    counters.push_back(make_pair("busupgr", ct_BusUpgr));
+    counters.push_back(make_pair("atomics", ct_atomics));
+    counters.push_back(make_pair("fences", ct_fences));
+    counters.push_back(make_pair("sc_success", ct_sc_success));
+    counters.push_back(make_pair("sc_failures", ct_sc_failures));
+    if(prefetcher != NULL) {
+        counters.push_back(make_pair("prefetches", ct_prefetches));
+        counters.push_back(make_pair("prefetch_useful", ct_prefetch_useful));
+        counters.push_back(make_pair("prefetch_unused", ct_prefetch_unused));
+        counters.push_back(make_pair("prefetch_invalidated", ct_prefetch_invalidated));
+        counters.push_back(make_pair("prefetch_upgrades", ct_prefetch_upgrades));
+        counters.push_back(make_pair("prefetch_downgrades", ct_prefetch_downgrades));
+    }
+}
+
+/*rates are fractions, not percentages, and 0 when there is nothing to divide*/
+static double ratio(ulong num, ulong den)
+{
+    return den ? (double)num / (double)den : 0;
+}
+
+void Cache::getRates(rateList &rates)
+{
+    rates.push_back(make_pair("miss_rate", ratio(readMisses + writeMisses, reads + writes)));
+    rates.push_back(make_pair("read_miss_rate", ratio(readMisses, reads)));
+    rates.push_back(make_pair("write_miss_rate", ratio(writeMisses, writes)));
+    rates.push_back(make_pair("writeback_rate", ratio(writeBacks, reads + writes)));
+    if(prefetcher != NULL) {
+        // coverage: share of would-be demand misses that a prefetch removed
+        rates.push_back(make_pair("prefetch_accuracy", ratio(ct_prefetch_useful, ct_prefetches)));
+        rates.push_back(make_pair("prefetch_coverage",
+                                  ratio(ct_prefetch_useful, ct_prefetch_useful + readMisses + writeMisses)));
+    }
+}
+
+void Cache::printPrefetchStats(FILE *out)
+{
+    fprintf(out, "P1. number of prefetches: %lu\n", ct_prefetches);
+    fprintf(out, "P2. number of useful prefetches: %lu\n", ct_prefetch_useful);
+    fprintf(out, "P3. number of unused prefetches evicted: %lu\n", ct_prefetch_unused);
+    fprintf(out, "P4. number of prefetched lines invalidated before use: %lu\n", ct_prefetch_invalidated);
+    fprintf(out, "P5. number of upgrades on prefetched lines: %lu\n", ct_prefetch_upgrades);
+    fprintf(out, "P6. number of remote M/E copies downgraded by prefetches: %lu\n", ct_prefetch_downgrades);
+    fprintf(out, "P7. prefetch accuracy: %.3g%%\n", ratio(ct_prefetch_useful, ct_prefetches) * 100);
+    fprintf(out, "P8. prefetch coverage: %.3g%%\n",
+            ratio(ct_prefetch_useful, ct_prefetch_useful + readMisses + writeMisses) * 100);
+}
+
+void Cache::printSyncStats(FILE *out)
+{
+    fprintf(out, "S1. number of atomic read-modify-writes: %lu\n", ct_atomics);
+    fprintf(out, "S2. number of fences: %lu\n", ct_fences);
+    fprintf(out, "S3. number of successful store-conditionals: %lu\n", ct_sc_success);
+    fprintf(out, "S4. number of failed store-conditionals: %lu\n", ct_sc_failures);
 }
 
 //MSI protocol
@@ -197,7 +327,7 @@ busRequestType MSI_Cache::Access(ulong addr,uchar op){
 
     cacheLine *line = findLine(addr);
     if (line == NULL)/*miss*/{
-        if (op == 'w') writeMisses++;
+        if (isWriteOp(op)) writeMisses++;
         else readMisses++;
         cacheLine *newline = fillLine(addr);
         line = newline;
@@ -211,7 +341,7 @@ busRequestType MSI_Cache::Access(ulong addr,uchar op){
     if(line != NULL) {
         switch (line->getFlags()) {
             case STATE_INVALID:
-                if (op == 'w') {
+                if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                     broadcaseReq = BUS_REQ_READX;
                     ct_BusRdX++;
@@ -222,7 +352,7 @@ busRequestType MSI_Cache::Access(ulong addr,uchar op){
                 ct_memory_transactions++;
                 break;
             case STATE_SHARED:
-                if (op == 'w') {
+                if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                     broadcaseReq = BUS_REQ_READX;
                     ct_BusRdX++;
@@ -287,7 +417,7 @@ busRequestType MSI_BusUpgr_Cache::Access(ulong addr,uchar op){
     //MSI with bus upgrade processor request handling
     cacheLine *line = findLine(addr);
     if (line == NULL)/*miss*/{
-        if (op == 'w') writeMisses++;
+        if (isWriteOp(op)) writeMisses++;
         else readMisses++;
         cacheLine *newline = fillLine(addr);
         line = newline;
@@ -300,7 +430,7 @@ busRequestType MSI_BusUpgr_Cache::Access(ulong addr,uchar op){
     if(line != NULL) {
         switch (line->getFlags()) {
             case STATE_INVALID:
-                if (op == 'w') {
+                if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                     broadcaseReq = BUS_REQ_READX;
                     ct_BusRdX++;
@@ -311,7 +441,13 @@ busRequestType MSI_BusUpgr_Cache::Access(ulong addr,uchar op){
                 ct_memory_transactions++;
                 break;
             case STATE_SHARED:
-                if (op == 'w') {
+                if (op == 'a') {
+                    //atomic RMW takes the line with one BusRdX, never an upgrade
+                    line->setFlags(STATE_MODIFIED);
+                    broadcaseReq = BUS_REQ_READX;
+                    ct_BusRdX++;
+                    ct_memory_transactions++;
+                } else if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                     broadcaseReq = BUS_REQ_UPGRADE;
                     ct_BusUpgr++;
@@ -381,7 +517,7 @@ busRequestType MESI_Cache::Access(ulong addr,uchar op){
     //MESI processor request handling
     cacheLine *line = findLine(addr);
     if (line == NULL)/*miss*/{
-        if (op == 'w') writeMisses++;
+        if (isWriteOp(op)) writeMisses++;
         else readMisses++;
         cacheLine *newline = fillLine(addr);
         line = newline;
@@ -394,7 +530,7 @@ busRequestType MESI_Cache::Access(ulong addr,uchar op){
     if(line != NULL) {
         switch (line->getFlags()) {
             case STATE_INVALID:
-                if (op == 'w') {
+                if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                     broadcaseReq = BUS_REQ_READX;
                     ct_BusRdX++;
@@ -405,14 +541,19 @@ busRequestType MESI_Cache::Access(ulong addr,uchar op){
                 //ct_memory_transactions++;
                 break;
             case STATE_SHARED:
-                if (op == 'w') {
+                if (op == 'a') {
+                    //atomic RMW takes the line with one BusRdX, never an upgrade
+                    line->setFlags(STATE_MODIFIED);
+                    broadcaseReq = BUS_REQ_READX;
+                    ct_BusRdX++;
+                } else if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                     broadcaseReq = BUS_REQ_UPGRADE;
                     ct_BusUpgr++;
                 }
                 break;
             case STATE_EXCLUSIVE:
-                if (op == 'w') {
+                if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                 }
                 break;
@@ -480,7 +621,7 @@ busRequestType MESI_Cache::snoop(ulong addr, busRequestType busReq, bool &isLine
 }
 
 //MESI with Snoop filter protocol
-MESI_Snoop_Filter_Cache::MESI_Snoop_Filter_Cache(int s,int a,int b ): Cache(s,a,b),SnoopFilter(1024,1,64)
+MESI_Snoop_Filter_Cache::MESI_Snoop_Filter_Cache(int s,int a,int b ): Cache(s,a,b),SnoopFilter(SNOOP_FILTER_SIZE,SNOOP_FILTER_ASSOC,SNOOP_FILTER_BLOCK)
 {
     //Add any MESI_Snoop_Filter specific initialization here
     ct_snoop_filter_useful = 0;
@@ -488,6 +629,42 @@ MESI_Snoop_Filter_Cache::MESI_Snoop_Filter_Cache(int s,int a,int b ): Cache(s,a,
     ct_snoop_filter_filtered = 0;
 }
 
+void MESI_Snoop_Filter_Cache::reset()
+{
+    Cache::reset();
+    SnoopFilter.reset();
+    ct_snoop_filter_useful = 0;
+    ct_snoop_filter_wasted = 0;
+    ct_snoop_filter_filtered = 0;
+}
+
+void MESI_Snoop_Filter_Cache::getCounters(counterList &counters)
+{
+    Cache::getCounters(counters);
+    counters.push_back(make_pair("snoop_filter_useful", ct_snoop_filter_useful));
+    counters.push_back(make_pair("snoop_filter_wasted", ct_snoop_filter_wasted));
+    counters.push_back(make_pair("snoop_filter_filtered", ct_snoop_filter_filtered));
+}
+
+void MESI_Snoop_Filter_Cache::getRates(rateList &rates)
+{
+    ulong snoops = ct_snoop_filter_useful + ct_snoop_filter_wasted + ct_snoop_filter_filtered;
+    Cache::getRates(rates);
+    rates.push_back(make_pair("snoop_filter_filtered_rate", ratio(ct_snoop_filter_filtered, snoops)));
+    rates.push_back(make_pair("snoop_filter_wasted_rate", ratio(ct_snoop_filter_wasted, snoops)));
+}
+
+cacheLine *MESI_Snoop_Filter_Cache::prefetchFill(ulong addr)
+{
+    //the line is about to be cached again, stop filtering its snoops
+    cacheLine * snoopLine = SnoopFilter.findLine(addr);
+    if(snoopLine != NULL)
+    {
+        snoopLine->setFlags(STATE_INVALID);
+    }
+    return Cache::prefetchFill(addr);
+}
+
 //This function handles processor R/W requests and MESI bus requests
 busRequestType MESI_Snoop_Filter_Cache::Access(ulong addr,uchar op){
     //This function handles processor R/W requests
@@ -497,7 +674,7 @@ busRequestType MESI_Snoop_Filter_Cache::Access(ulong addr,uchar op){
     cacheLine *line = findLine(addr);
     cacheLine * snoopLine = SnoopFilter.findLine(addr);
     if (line == NULL)/*miss*/{
-        if (op == 'w') writeMisses++;
+        if (isWriteOp(op)) writeMisses++;
         else readMisses++;
         cacheLine *newline = fillLine(addr);
         line = newline;
@@ -510,7 +687,7 @@ busRequestType MESI_Snoop_Filter_Cache::Access(ulong addr,uchar op){
     if(line != NULL) {
         switch (line->getFlags()) {
             case STATE_INVALID:
-                if (op == 'w') {
+                if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                     broadcaseReq = BUS_REQ_READX;
                     ct_BusRdX++;
@@ -529,14 +706,19 @@ busRequestType MESI_Snoop_Filter_Cache::Access(ulong addr,uchar op){
                 //ct_memory_transactions++;
                 break;
             case STATE_SHARED:
-                if (op == 'w') {
+                if (op == 'a') {
+                    //atomic RMW takes the line with one BusRdX, never an upgrade
+                    line->setFlags(STATE_MODIFIED);
+                    broadcaseReq = BUS_REQ_READX;
+                    ct_BusRdX++;
+                } else if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                     broadcaseReq = BUS_REQ_UPGRADE;
                     ct_BusUpgr++;
                 }
                 break;
             case STATE_EXCLUSIVE:
-                if (op == 'w') {
+                if (isWriteOp(op)) {
                     line->setFlags(STATE_MODIFIED);
                 }
                 break;
@@ -626,6 +808,286 @@ busRequestType MESI_Snoop_Filter_Cache::snoop(ulong addr, busRequestType busReq,
     return broadcaseReq;
 }
 
+//write-update protocols
+Update_Cache::Update_Cache(int s,int a,int b ): Cache(s,a,b)
+{
+    ct_update_words = 0;
+    ct_update_bytes = 0;
+    ct_updates_received = 0;
+}
+
+void Update_Cache::reset()
+{
+    Cache::reset();
+    ct_update_words = 0;
+    ct_update_bytes = 0;
+    ct_updates_received = 0;
+}
+
+void Update_Cache::sendUpdate()
+{
+    ct_update_words++;
+    ct_update_bytes += UPDATE_WORD_SIZE;
+}
+
+cacheLine *Update_Cache::prefetchFill(ulong addr)
+{
+    cacheLine *line = Cache::prefetchFill(addr);
+    line->setFlags(STATE_SHARED_CLEAN);
+    return line;
+}
+
+void Update_Cache::getCounters(counterList &counters)
+{
+    Cache::getCounters(counters);
+    counters.push_back(make_pair("update_words", ct_update_words));
+    counters.push_back(make_pair("update_bytes", ct_update_bytes));
+    counters.push_back(make_pair("updates_received", ct_updates_received));
+}
+
+void Update_Cache::printUpdateStats(FILE *out)
+{
+    fprintf(out, "14. number of update words sent: %lu\n", ct_update_words);
+    fprintf(out, "15. number of update bytes sent: %lu\n", ct_update_bytes);
+    fprintf(out, "16. number of updates received: %lu\n", ct_updates_received);
+}
+
+//Dragon protocol
+Dragon_Cache::Dragon_Cache(int s,int a,int b ): Update_Cache(s,a,b)
+{
+    //Add any Dragon specific initialization here
+}
+
+//This function handles processor R/W requests and Dragon bus requests
+busRequestType Dragon_Cache::Access(ulong addr,uchar op){
+    //This function handles processor R/W requests
+    Cache::Access(addr, op);
+
+    cacheLine *line = findLine(addr);
+    if (line == NULL)/*miss*/{
+        if (isWriteOp(op)) writeMisses++;
+        else readMisses++;
+        cacheLine *newline = fillLine(addr);
+        line = newline;
+    } else {
+        /**since it's a hit, update LRU and update dirty flag**/
+        updateLRU(line);
+    }
+
+    //Dragon processor request handling
+    busRequestType broadcaseReq = BUS_REQ_MAX;
+    if(line != NULL) {
+        switch (line->getFlags()) {
+            case STATE_INVALID:
+                //misses always read, busResult decides between M and BusUpd
+                line->setFlags(isWriteOp(op) ? STATE_MODIFIED : STATE_SHARED_CLEAN);
+                broadcaseReq = BUS_REQ_READ;
+                break;
+            case STATE_SHARED_CLEAN:
+            case STATE_SHARED_MODIFIED:
+                //an atomic ('a') is a write here too: update protocols have no
+                //BusRdX, sharers keep their copies, and the single BusUpd
+                //carrying the new value holds the bus, so no other write to
+                //the word can fall between the read and the write
+                if (isWriteOp(op)) {
+                    line->setFlags(STATE_SHARED_MODIFIED);
+                    broadcaseReq = BUS_REQ_UPDATE;
+                    sendUpdate();
+                }
+                break;
+            case STATE_EXCLUSIVE:
+                if (isWriteOp(op)) {
+                    line->setFlags(STATE_MODIFIED);
+                }
+                break;
+            case STATE_MODIFIED:
+                break;
+        }
+    }
+    return broadcaseReq;
+}
+
+busRequestType Dragon_Cache::busResult(ulong addr, uchar op, busRequestType busReq, bool shared)
+{
+    cacheLine *line = findLine(addr);
+    if(line == NULL || !isWriteOp(op)) {
+        return BUS_REQ_MAX;
+    }
+    if(busReq == BUS_REQ_READ) {
+        if(shared) {
+            line->setFlags(STATE_SHARED_MODIFIED);
+            sendUpdate();
+            return BUS_REQ_UPDATE;
+        }
+        line->setFlags(STATE_MODIFIED);
+    } else if(busReq == BUS_REQ_UPDATE) {
+        line->setFlags(shared ? STATE_SHARED_MODIFIED : STATE_MODIFIED);
+    }
+    return BUS_REQ_MAX;
+}
+
+busRequestType Dragon_Cache::snoop(ulong addr, busRequestType busReq, bool &isLinePresent) {
+    //Dragon bus requests handling, only the owner (M or Sm) supplies data
+    cacheLine *line = findLine(addr);
+    busRequestType broadcaseReq = BUS_REQ_MAX;
+
+    if(line != NULL && busReq != BUS_REQ_MAX) {
+        switch (line->getFlags()) {
+            case STATE_INVALID:
+                break;
+            case STATE_EXCLUSIVE:
+                if (busReq == BUS_REQ_READ) {
+                    line->setFlags(STATE_SHARED_CLEAN);
+                    ct_interventions++;
+                }
+                isLinePresent = true;
+                break;
+            case STATE_SHARED_CLEAN:
+                if (busReq == BUS_REQ_UPDATE) {
+                    ct_updates_received++;
+                }
+                isLinePresent = true;
+                break;
+            case STATE_SHARED_MODIFIED:
+                if (busReq == BUS_REQ_READ) {
+                    broadcaseReq = BUS_REQ_FLUSH;
+                    ct_flushes++;
+                } else if (busReq == BUS_REQ_UPDATE) {
+                    //the writer becomes the owner
+                    line->setFlags(STATE_SHARED_CLEAN);
+                    ct_updates_received++;
+                }
+                isLinePresent = true;
+                break;
+            case STATE_MODIFIED:
+                if (busReq == BUS_REQ_READ) {
+                    line->setFlags(STATE_SHARED_MODIFIED);
+                    ct_interventions++;
+                    broadcaseReq = BUS_REQ_FLUSH;
+                    ct_flushes++;
+                }
+                isLinePresent = true;
+                break;
+        }
+    }
+    return broadcaseReq;
+}
+
+//Firefly protocol
+Firefly_Cache::Firefly_Cache(int s,int a,int b ): Update_Cache(s,a,b)
+{
+    //Add any Firefly specific initialization here
+}
+
+//This function handles processor R/W requests and Firefly bus requests
+busRequestType Firefly_Cache::Access(ulong addr,uchar op){
+    //This function handles processor R/W requests
+    Cache::Access(addr, op);
+
+    cacheLine *line = findLine(addr);
+    if (line == NULL)/*miss*/{
+        if (isWriteOp(op)) writeMisses++;
+        else readMisses++;
+        cacheLine *newline = fillLine(addr);
+        line = newline;
+    } else {
+        /**since it's a hit, update LRU and update dirty flag**/
+        updateLRU(line);
+    }
+
+    //Firefly processor request handling
+    busRequestType broadcaseReq = BUS_REQ_MAX;
+    if(line != NULL) {
+        switch (line->getFlags()) {
+            case STATE_INVALID:
+                //misses always read, busResult decides between M and BusUpd
+                line->setFlags(isWriteOp(op) ? STATE_MODIFIED : STATE_SHARED_CLEAN);
+                broadcaseReq = BUS_REQ_READ;
+                break;
+            case STATE_SHARED_CLEAN:
+                if (isWriteOp(op)) {
+                    //write through to memory along with the update; an atomic
+                    //takes the same single BusUpd, as in Dragon
+                    broadcaseReq = BUS_REQ_UPDATE;
+                    sendUpdate();
+                    ct_memory_transactions++;
+                }
+                break;
+            case STATE_EXCLUSIVE:
+                if (isWriteOp(op)) {
+                    line->setFlags(STATE_MODIFIED);
+                }
+                break;
+            case STATE_MODIFIED:
+                break;
+        }
+    }
+    return broadcaseReq;
+}
+
+busRequestType Firefly_Cache::busResult(ulong addr, uchar op, busRequestType busReq, bool shared)
+{
+    cacheLine *line = findLine(addr);
+    if(line == NULL || !isWriteOp(op)) {
+        return BUS_REQ_MAX;
+    }
+    if(busReq == BUS_REQ_READ) {
+        if(shared) {
+            line->setFlags(STATE_SHARED_CLEAN);
+            sendUpdate();
+            ct_memory_transactions++;
+            return BUS_REQ_UPDATE;
+        }
+        line->setFlags(STATE_MODIFIED);
+    } else if(busReq == BUS_REQ_UPDATE) {
+        //memory is current after the write-through
+        line->setFlags(shared ? STATE_SHARED_CLEAN : STATE_EXCLUSIVE);
+    }
+    return BUS_REQ_MAX;
+}
+
+busRequestType Firefly_Cache::snoop(ulong addr, busRequestType busReq, bool &isLinePresent) {
+    //Firefly bus requests handling, every holder supplies data
+    cacheLine *line = findLine(addr);
+    busRequestType broadcaseReq = BUS_REQ_MAX;
+
+    if(line != NULL && busReq != BUS_REQ_MAX) {
+        switch (line->getFlags()) {
+            case STATE_INVALID:
+                break;
+            case STATE_EXCLUSIVE:
+                if (busReq == BUS_REQ_READ) {
+                    line->setFlags(STATE_SHARED_CLEAN);
+                    broadcaseReq = BUS_REQ_FLUSH;
+                    ct_interventions++;
+                }
+                isLinePresent = true;
+                break;
+            case STATE_SHARED_CLEAN:
+                if (busReq == BUS_REQ_READ) {
+                    broadcaseReq = BUS_REQ_FLUSH;
+                } else if (busReq == BUS_REQ_UPDATE) {
+                    ct_updates_received++;
+                }
+                isLinePresent = true;
+                break;
+            case STATE_MODIFIED:
+                if (busReq == BUS_REQ_READ) {
+                    //memory picks up the flush, the line is clean from now on
+                    line->setFlags(STATE_SHARED_CLEAN);
+                    ct_interventions++;
+                    broadcaseReq = BUS_REQ_FLUSH;
+                    ct_flushes++;
+                    ct_memory_transactions++;
+                    writeBacks++;
+                }
+                isLinePresent = true;
+                break;
+        }
+    }
+    return broadcaseReq;
+}
+
 //MOESI protocol
 MOESI_Cache::MOESI_Cache(int s,int a,int b ): Cache(s,a,b)
 {
@@ -6,15 +6,21 @@
 #define CACHE_H
 
 #include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <iomanip>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 typedef unsigned long ulong;
 typedef unsigned char uchar;
 typedef unsigned int uint;
 
-extern ulong protocol;
+/*named counters and derived rates, in report order*/
+typedef std::vector<std::pair<const char *, ulong> > counterList;
+typedef std::vector<std::pair<const char *, double> > rateList;
+
 /****add new states, based on the protocol****/
 enum {
     STATE_INVALID = 0,
@@ -22,35 +28,47 @@ enum {
     STATE_OWNED,
     STATE_EXCLUSIVE,
     STATE_SHARED,
+    STATE_SHARED_CLEAN,      // Sc: update protocols, memory or an Sm copy owns the line
+    STATE_SHARED_MODIFIED,   // Sm: Dragon owner of a dirty shared line
     STATE_MAX
 };
 
 
+/*trace operations: r read, w write, a atomic read-modify-write, f fence,
+  l load-linked, c store-conditional*/
+inline bool isWriteOp(uchar op) { return op == 'w' || op == 'a' || op == 'c'; }
+
 enum busRequestType{
     BUS_REQ_UPGRADE = 0,
     BUS_REQ_READ,
     BUS_REQ_READX,
     BUS_REQ_FLUSH,
+    BUS_REQ_UPDATE,          // one written word broadcast to the other sharers
     BUS_REQ_MAX
 };
 
+class Prefetcher;
+
 class cacheLine 
 {
 protected:
    ulong tag;
    ulong Flags;   // 0:invalid, 1:valid, 2:dirty 
    ulong seq;
+   bool prefetched;   // filled by a prefetch and not yet used by a demand access
  
 public:
-   cacheLine()                { tag = 0; Flags = 0; }
+   cacheLine()                { tag = 0; Flags = 0; prefetched = false; }
    ulong getTag()             { return tag; }
    ulong getFlags()           { return Flags;}
    ulong getSeq()             { return seq; }
    void setSeq(ulong Seq)     { seq = Seq;}
    void setFlags(ulong flags) {  Flags = flags;}
    void setTag(ulong a)       { tag = a; }
-   void invalidate()          { tag = 0; Flags = STATE_INVALID; } //useful function
+   void invalidate()          { tag = 0; Flags = STATE_INVALID; prefetched = false; } //useful function
    bool isValid()             { return ((Flags) != STATE_INVALID); }
+   bool isPrefetched()        { return prefetched; }
+   void setPrefetched(bool p) { prefetched = p; }
 };
 
 class Cache
@@ -79,13 +97,33 @@ public:
     ulong ct_BusRdX;
     ulong ct_BusUpgr;
 
+    // optional hardware prefetcher, NULL when disabled
+    Prefetcher *prefetcher;
+    ulong ct_prefetches;             // prefetch fills issued as BusRd
+    ulong ct_prefetch_useful;        // prefetched lines later touched by a demand access
+    ulong ct_prefetch_unused;        // prefetched lines evicted before any use
+    ulong ct_prefetch_invalidated;   // prefetched lines invalidated by a snoop before any use
+    ulong ct_prefetch_upgrades;      // bus upgrades/BusRdX on the first write to a prefetched line
+    ulong ct_prefetch_downgrades;    // M/E copies in other caches demoted by a prefetch
+
+    // synchronization
+    ulong ct_atomics;        // atomic RMW accesses
+    ulong ct_fences;
+    ulong ct_sc_success;
+    ulong ct_sc_failures;
+    bool linkValid;          // LL reservation, dropped when the line is lost or written remotely
+    ulong linkBlock;
+
     ulong currentCycle;  
      
     Cache(int,int,int);
-   ~Cache() { delete cache;}
+   virtual ~Cache();
+   /*zero the counters and invalidate every line, keeping the allocation*/
+   virtual void reset();
    
    cacheLine *findLineToReplace(ulong addr);
    cacheLine *fillLine(ulong addr);
+   virtual cacheLine *prefetchFill(ulong addr);
    cacheLine * findLine(ulong addr);
    cacheLine * getLRU(ulong);
    
@@ -94,11 +132,21 @@ public:
    ulong getReads()  {return reads;}       
    ulong getWrites() {return writes;}
    ulong getWB()     {return writeBacks;}
+   ulong blockOf(ulong addr) {return calcTag(addr);}
    
    void writeBack(ulong) {writeBacks++;}
    virtual busRequestType Access(ulong,uchar);
    virtual busRequestType snoop(ulong addr, busRequestType busReq, bool &isLinePresent);
-   void printStats();
+   /*called with the request Access returned once every other cache has
+     snooped it; may settle the line's state and return a second request
+     to broadcast (update protocols), BUS_REQ_MAX if none*/
+   virtual busRequestType busResult(ulong addr, uchar op, busRequestType busReq, bool shared) {return BUS_REQ_MAX;}
+   void printStats(FILE *out);
+   void printPrefetchStats(FILE *out);
+   void printSyncStats(FILE *out);
+   bool sawSyncOps() {return (ct_atomics | ct_fences | ct_sc_success | ct_sc_failures) != 0;}
+   virtual void getCounters(counterList &counters);
+   virtual void getRates(rateList &rates);
    void updateLRU(cacheLine *);
 
    //******///
@@ -135,6 +183,11 @@ public:
 
 };
 
+// geometry of the per-cache snoop filter (size, assoc, block size)
+const int SNOOP_FILTER_SIZE  = 1024;
+const int SNOOP_FILTER_ASSOC = 1;
+const int SNOOP_FILTER_BLOCK = 64;
+
 class MESI_Snoop_Filter_Cache: public Cache
 {
 public:
@@ -144,10 +197,61 @@ public:
     ulong ct_snoop_filter_filtered;
     busRequestType Access(ulong,uchar);
     busRequestType snoop(ulong addr, busRequestType busReq, bool &isLinePresent);
+    void getCounters(counterList &counters);
+    void getRates(rateList &rates);
+    cacheLine *prefetchFill(ulong addr);
+    void reset();
     MESI_Snoop_Filter_Cache(int,int,int);
 
 };
 
+// bytes carried by one BusUpd, traces do not record access sizes
+const int UPDATE_WORD_SIZE = 4;
+
+/*common part of the write-update protocols: writes to shared lines are
+  broadcast as BusUpd and sharers keep their copies up to date instead of
+  invalidating them. Atomics ('a') follow the write path rather than the
+  invalidation protocols' single BusRdX; an atomic miss on a shared line
+  issues its BusRd and BusUpd in the same bus step, with nothing between*/
+class Update_Cache: public Cache
+{
+protected:
+    void sendUpdate();
+public:
+    ulong ct_update_words;
+    ulong ct_update_bytes;
+    ulong ct_updates_received;
+    cacheLine *prefetchFill(ulong addr);
+    void reset();
+    void getCounters(counterList &counters);
+    void printUpdateStats(FILE *out);
+    Update_Cache(int,int,int);
+};
+
+/*Dragon: E, Sc, Sm, M; memory is not updated on BusUpd, the last writer
+  owns the line in Sm and writes it back on eviction*/
+class Dragon_Cache: public Update_Cache
+{
+public:
+    busRequestType Access(ulong,uchar);
+    busRequestType snoop(ulong addr, busRequestType busReq, bool &isLinePresent);
+    busRequestType busResult(ulong addr, uchar op, busRequestType busReq, bool shared);
+    Dragon_Cache(int,int,int);
+
+};
+
+/*Firefly: E, Sc, M; writes to shared lines go through to memory with the
+  BusUpd, so shared lines are always clean*/
+class Firefly_Cache: public Update_Cache
+{
+public:
+    busRequestType Access(ulong,uchar);
+    busRequestType snoop(ulong addr, busRequestType busReq, bool &isLinePresent);
+    busRequestType busResult(ulong addr, uchar op, busRequestType busReq, bool shared);
+    Firefly_Cache(int,int,int);
+
+};
+
 class MOESI_Cache: public Cache
 {
 public:
@@ -0,0 +1,232 @@
+/*******************************************************
+                          gen.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "gen.h"
+using namespace std;
+
+const char *genPatternName[GEN_MAX] = {
+    "private", "readmostly", "prodcons", "migratory", "lock", "falseshare"
+};
+
+/*default write fraction per pattern, where the pattern uses one*/
+static const double genDefaultWrites[GEN_MAX] = { 0.3, 0.02, 0, 0, 0.3, 0.5 };
+
+static const ulong MIGRATORY_OBJ_LINES = 4;
+static const ulong LOCK_STRIDE_LINES   = 8;   /*lock line followed by its data*/
+static const ulong LOCK_CS_ACCESSES    = 4;
+/*per processor lock phases: idle, spinning, critical section, fence, release*/
+static const ulong LOCK_IDLE           = 0;
+static const ulong LOCK_SPIN           = 1;
+static const ulong LOCK_FENCE          = LOCK_SPIN + 1 + LOCK_CS_ACCESSES;
+
+/*number with an optional k/m/g suffix, false if malformed*/
+static bool parseSize(const char *s, ulong &val)
+{
+    char *end;
+    val = strtoul(s, &end, 0);
+    if(end == s) return false;
+    switch(*end) {
+        case 'k': case 'K': val <<= 10; end++; break;
+        case 'm': case 'M': val <<= 20; end++; break;
+        case 'g': case 'G': val <<= 30; end++; break;
+    }
+    return *end == '\0';
+}
+
+TraceGenerator::TraceGenerator()
+{
+    pattern = GEN_PRIVATE;
+    records = 1000000;
+    procs = 4;
+    footprint = 4 * 1024;
+    blkSize = 64;
+    seed = 1;
+    writeRatio = genDefaultWrites[GEN_PRIVATE];
+    rewind();
+}
+
+bool TraceGenerator::configure(const char *spec, ulong num_processors, ulong blk_size)
+{
+    string s(spec);
+    size_t pos = s.find(',');
+    string name = s.substr(0, pos);
+
+    int p;
+    for(p = 0; p < GEN_MAX; p++) {
+        if(name == genPatternName[p]) break;
+    }
+    if(p == GEN_MAX) return false;
+    pattern = (genPattern)p;
+    procs = num_processors;
+    blkSize = blk_size;
+    writeRatio = genDefaultWrites[p];
+
+    while(pos != string::npos) {
+        size_t start = pos + 1;
+        pos = s.find(',', start);
+        string kv = s.substr(start, pos == string::npos ? string::npos : pos - start);
+        size_t eq = kv.find('=');
+        if(eq == string::npos) return false;
+        string key = kv.substr(0, eq);
+        const char *val = kv.c_str() + eq + 1;
+
+        if(key == "records") {
+            if(!parseSize(val, records)) return false;
+        } else if(key == "procs") {
+            if(!parseSize(val, procs)) return false;
+        } else if(key == "footprint") {
+            if(!parseSize(val, footprint)) return false;
+        } else if(key == "seed") {
+            if(!parseSize(val, seed)) return false;
+        } else if(key == "writes") {
+            char *end;
+            writeRatio = strtod(val, &end);
+            if(*end != '\0' || writeRatio < 0 || writeRatio > 1) return false;
+        } else {
+            return false;
+        }
+    }
+    if(procs == 0 || procs > num_processors || blkSize == 0 || footprint < blkSize) {
+        return false;
+    }
+    rewind();
+    return true;
+}
+
+void TraceGenerator::rewind()
+{
+    emitted = 0;
+    rng = seed * 0x9E3779B97F4A7C15UL + 1;
+    writeThreshold = (ulong)(writeRatio * (double)(1UL << 53));
+    lines = footprint / blkSize;
+    step.assign(procs, 0);
+    lockOf.assign(procs, 0);
+    lockHolder.assign((lines + LOCK_STRIDE_LINES - 1) / LOCK_STRIDE_LINES, ULONG_MAX);
+    curProc = curObj = curStep = curLen = 0;
+}
+
+string TraceGenerator::describe()
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s,records=%lu,procs=%lu,footprint=%lu,writes=%g,seed=%lu",
+             genPatternName[pattern], records, procs, footprint, writeRatio, seed);
+    return string(buf);
+}
+
+ulong TraceGenerator::nextRand()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+void TraceGenerator::next(TraceRecord &rec)
+{
+    switch(pattern) {
+        case GEN_PRIVATE: {
+            ulong p = emitted % procs;
+            rec.proc = p;
+            rec.op = randOp();
+            rec.addr = privateBase(p) + step[p];
+            step[p] += sizeof(ulong);
+            if(step[p] >= footprint) step[p] = 0;
+            break;
+        }
+        case GEN_READ_MOSTLY:
+            rec.proc = nextRand() % procs;
+            rec.op = randOp();
+            rec.addr = (nextRand() % lines) * blkSize;
+            break;
+        case GEN_PROD_CONS: {
+            /*each processor alternates between filling its own buffer and
+              draining the one its predecessor filled*/
+            ulong p = emitted % procs;
+            ulong line = step[p] % lines;
+            rec.proc = p;
+            if((step[p] / lines) % 2 == 0) {
+                rec.op = 'w';
+                rec.addr = (p * lines + line) * blkSize;
+            } else {
+                rec.op = 'r';
+                rec.addr = (((p + procs - 1) % procs) * lines + line) * blkSize;
+            }
+            step[p]++;
+            break;
+        }
+        case GEN_MIGRATORY: {
+            ulong objLines = lines < MIGRATORY_OBJ_LINES ? lines : MIGRATORY_OBJ_LINES;
+            if(curStep == curLen) {
+                /*hand the next object to a different processor*/
+                curProc = (procs > 1) ? (curProc + 1 + nextRand() % (procs - 1)) % procs : 0;
+                curObj = nextRand() % (lines / objLines);
+                curStep = 0;
+                curLen = 2 * objLines;
+            }
+            rec.proc = curProc;
+            rec.op = (curStep < objLines) ? 'r' : 'w';
+            rec.addr = (curObj * objLines + curStep % objLines) * blkSize;
+            curStep++;
+            break;
+        }
+        case GEN_LOCK: {
+            /*processors take turns, so waiters spin on the lock line while
+              another one holds it and see the release invalidate it*/
+            ulong p = emitted % procs;
+            ulong locks = (lines + LOCK_STRIDE_LINES - 1) / LOCK_STRIDE_LINES;
+            if(step[p] == LOCK_IDLE) {
+                lockOf[p] = nextRand() % locks;
+                step[p] = LOCK_SPIN;
+            }
+            ulong lock = lockOf[p];
+            ulong lockAddr = lock * LOCK_STRIDE_LINES * blkSize;
+            rec.proc = p;
+            rec.addr = lockAddr;
+            if(step[p] == LOCK_SPIN) {
+                if(lockHolder[lock] == ULONG_MAX) {
+                    rec.op = 'a';
+                    lockHolder[lock] = p;
+                    step[p]++;
+                } else {
+                    rec.op = 'r';
+                }
+            } else if(step[p] < LOCK_FENCE) {
+                rec.op = randOp();
+                rec.addr = lockAddr + (1 + nextRand() % (LOCK_STRIDE_LINES - 1)) * blkSize;
+                step[p]++;
+            } else if(step[p] == LOCK_FENCE) {
+                rec.op = 'f';
+                step[p]++;
+            } else {
+                rec.op = 'w';
+                lockHolder[lock] = ULONG_MAX;
+                step[p] = LOCK_IDLE;
+            }
+            break;
+        }
+        case GEN_FALSE_SHARING: {
+            ulong p = emitted % procs;
+            rec.proc = p;
+            rec.op = randOp();
+            rec.addr = (nextRand() % lines) * blkSize + (p * sizeof(ulong)) % blkSize;
+            break;
+        }
+        default:
+            break;
+    }
+    emitted++;
+}
+
+ulong TraceGenerator::fill(TraceRecord *buf, ulong n)
+{
+    if(n > records - emitted) n = records - emitted;
+    for(ulong i = 0; i < n; i++) {
+        next(buf[i]);
+    }
+    return n;
+}
@@ -0,0 +1,62 @@
+/*******************************************************
+                          gen.h
+********************************************************/
+
+#ifndef GEN_H
+#define GEN_H
+
+#include <string>
+#include <vector>
+#include "sim.h"
+
+enum genPattern {
+    GEN_PRIVATE = 0,     /*each processor streams through its own region*/
+    GEN_READ_MOSTLY,     /*all processors read a shared region, rare writes*/
+    GEN_PROD_CONS,       /*processor p fills a buffer that p+1 then reads*/
+    GEN_MIGRATORY,       /*objects are read then written by one processor at a time*/
+    GEN_LOCK,            /*contended locks: spin, atomic acquire, critical section, fence, release*/
+    GEN_FALSE_SHARING,   /*processors write disjoint words of the same lines*/
+    GEN_MAX
+};
+
+/*Synthetic sharing-pattern workload, produced in memory in batches so it can
+  be fed to the simulator without a trace file. Configured from a spec string
+
+     <pattern>[,records=N][,procs=N][,footprint=BYTES][,writes=FRAC][,seed=N]
+
+  where pattern is one of private, readmostly, prodcons, migratory, lock,
+  falseshare. Sizes accept k/m/g suffixes. footprint is the region one
+  processor streams through (private) or fills (prodcons), and the shared
+  region for the other patterns.*/
+class TraceGenerator: public TraceSource
+{
+protected:
+   genPattern pattern;
+   ulong records, procs, footprint, blkSize, seed;
+   double writeRatio;
+
+   ulong emitted;
+   ulong rng;
+   ulong writeThreshold;
+   ulong lines;
+   std::vector<ulong> step;   /*per processor position in the pattern*/
+   std::vector<ulong> lockOf;      /*lock pattern: lock each processor wants or holds*/
+   std::vector<ulong> lockHolder;  /*per lock, holding processor or ULONG_MAX*/
+   ulong curProc, curObj, curStep, curLen;
+
+   ulong nextRand();
+   uchar randOp()                { return ((nextRand() >> 11) < writeThreshold) ? 'w' : 'r'; }
+   ulong privateBase(ulong p)    { return (p + 1) << 32; }
+   void next(TraceRecord &rec);
+
+public:
+   TraceGenerator();
+   bool configure(const char *spec, ulong num_processors, ulong blk_size);
+   void rewind();
+   std::string describe();
+   ulong fill(TraceRecord *buf, ulong n);
+};
+
+extern const char *genPatternName[GEN_MAX];
+
+#endif
@@ -3,22 +3,70 @@
 ********************************************************/
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <signal.h>
+#include <time.h>
+#include <algorithm>
 #include <fstream>
 #include <string>
+#include <vector>
 using namespace std;
 
 #include "cache.h"
-ulong protocol;
-int main(int argc, char *argv[])
+#include "sim.h"
+#include "gen.h"
+#include "trace.h"
+#include "merge.h"
+#include "stats.h"
+#include "profile.h"
+#include "resultcache.h"
+
+static volatile sig_atomic_t stopRequested = 0;
+
+/*first ^C ends the run after the current batch and still prints the
+  statistics, a second one kills the process*/
+static void requestStop(int)
 {
-    
-    ifstream fin;
-    FILE * pFile;
+    stopRequested = 1;
+}
+
+static ulong readRecords(TraceSource *source, TraceRecord *batch, ulong n)
+{
+    PROF_SCOPE(PROF_TRACE_READ);
+    return source->fill(batch, n);
+}
+
+static double wallSecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-    if(argv[1] == NULL){
+int main(int argc, char *argv[])
+{
+    if(argc < 7){
          printf("input format: ");
-         printf("./smp_cache <cache_size> <assoc> <block_size> <num_processors> <protocol> <trace_file> \n");
+         printf("./smp_cache <cache_size> <assoc> <block_size> <num_processors> <protocol> <trace_file> [options]\n");
+         printf("       <trace_file> may be gen:<pattern>[,records=N][,procs=N][,footprint=BYTES][,writes=FRAC][,seed=N]\n");
+         printf("       with <pattern> one of private, readmostly, prodcons, migratory, lock, falseshare,\n");
+         printf("       or merge:<file0>,<file1>,... (or merge:@<list file>) to interleave per-core traces,\n");
+         printf("       file k holding processor k's records as \"[<timestamp>] <op> <hex addr>\",\n");
+         printf("       or - to read records from stdin (a named pipe works as a plain path)\n");
+         printf("       records are \"<proc> <op> <hex addr>\", <op> one of r (read), w (write), a (atomic\n");
+         printf("       read-modify-write), f (fence), l (load-linked) or c (store-conditional)\n");
+         printf("options:\n");
+         printf("  --format text|json|csv     format of the final statistics (default text)\n");
+         printf("  --interval <N> <file>      write per-cache counter deltas every N accesses as csv\n");
+         printf("  --prefetch <kind>[:<degree>]  per-cache prefetcher: next, stride or stream (default degree 1)\n");
+         printf("  --progress <N>             print progress and running totals on stderr every N accesses\n");
+         printf("  --result-cache <dir>       reuse the stored result of an identical earlier run\n");
+         printf("                             of the same clean git revision\n");
+         printf("  --profile                  print a per-phase time breakdown of the simulator on stderr\n");
+         printf("  --check <fraction>         verify coherence invariants after this fraction of the records\n");
+         printf("                             (1 = every record) and report the first violation on stderr\n");
+         printf("  --merge-ties               order equal merge timestamps by file, not by heap position\n");
          exit(0);
         }
 
@@ -26,113 +74,257 @@ int main(int argc, char *argv[])
     ulong cache_assoc    = atoi(argv[2]);
     ulong blk_size       = atoi(argv[3]);
     ulong num_processors = atoi(argv[4]);
-    protocol       = atoi(argv[5]); /* 0:MSI 1:MSI BusUpgr 2:MESI 3:MESI Snoop FIlter */
-    char *fname        = (char *) malloc(20);
-    fname              = argv[6];
-    string protocol_name[4] = {"MSI", "MSI BusUpgr", "MESI", "MESI Filter"};
-    printf("===== 506 Coherence Simulator Configuration =====\n");
-    printf("L1_SIZE: %ld\n", cache_size);
-    printf("L1_ASSOC: %ld\n", cache_assoc);
-    printf("L1_BLOCKSIZE: %ld\n", blk_size);
-    printf("NUMBER OF PROCESSORS: %ld\n", num_processors);
-    printf("COHERENCE PROTOCOL: %s\n", protocol_name[protocol].c_str());
-    printf("TRACE FILE: %s\n", fname);
-    // print out simulator configuration here
-    
-    // Using pointers so that we can use inheritance */
-    Cache** cacheArray = (Cache **) malloc(num_processors * sizeof(Cache));
-    for(ulong i = 0; i < num_processors; i++) {
-        if(protocol == 0) {
-            cacheArray[i] = new MSI_Cache(cache_size, cache_assoc, blk_size);
-        } else if (protocol == 1) {
-            cacheArray[i] = new MSI_BusUpgr_Cache(cache_size, cache_assoc, blk_size);
-        } else if (protocol == 2) {
-            cacheArray[i] = new MESI_Cache(cache_size, cache_assoc, blk_size);
-        } else if (protocol == 3) {
-            cacheArray[i] = new MESI_Snoop_Filter_Cache(cache_size, cache_assoc, blk_size);
+    ulong protocol       = atoi(argv[5]); /* 0:MSI 1:MSI BusUpgr 2:MESI 3:MESI Snoop FIlter 4:Dragon 5:Firefly */
+    const char *fname    = argv[6];
+
+    statsFormat format = STATS_TEXT;
+    ulong interval = 0;
+    const char *intervalFile = NULL;
+    bool profile = false;
+    ulong progress = 0;
+    const char *resultDir = NULL;
+    prefetchKind prefetch = PREFETCH_NONE;
+    ulong prefetchDegree = 1;
+    bool mergeTies = false;
+    double checkRate = 0;
+    for(int i = 7; i < argc; i++) {
+        if(strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if(strcmp(argv[i], "json") == 0) format = STATS_JSON;
+            else if(strcmp(argv[i], "csv") == 0) format = STATS_CSV;
+            else if(strcmp(argv[i], "text") == 0) format = STATS_TEXT;
+            else {
+                printf("Invalid format %s\n", argv[i]);
+                exit(0);
+            }
+        } else if(strcmp(argv[i], "--interval") == 0 && i + 2 < argc) {
+            interval = strtoul(argv[i + 1], NULL, 0);
+            intervalFile = argv[i + 2];
+            i += 2;
+        } else if(strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc) {
+            i++;
+            const char *colon = strchr(argv[i], ':');
+            size_t len = colon ? (size_t)(colon - argv[i]) : strlen(argv[i]);
+            for(int k = PREFETCH_NEXT_LINE; k < PREFETCH_MAX; k++) {
+                if(strlen(prefetchName[k]) == len && strncmp(argv[i], prefetchName[k], len) == 0) {
+                    prefetch = (prefetchKind)k;
+                }
+            }
+            if(colon) prefetchDegree = strtoul(colon + 1, NULL, 0);
+            if(prefetch == PREFETCH_NONE || prefetchDegree == 0) {
+                printf("Invalid prefetcher %s\n", argv[i]);
+                exit(0);
+            }
+        } else if(strcmp(argv[i], "--progress") == 0 && i + 1 < argc) {
+            progress = strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--result-cache") == 0 && i + 1 < argc) {
+            resultDir = argv[++i];
+        } else if(strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if(strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+            checkRate = atof(argv[++i]);
+            if(checkRate <= 0 || checkRate > 1) {
+                printf("Invalid check fraction %s\n", argv[i]);
+                exit(0);
+            }
+        } else if(strcmp(argv[i], "--merge-ties") == 0) {
+            mergeTies = true;
         } else {
-            printf("Invalid protocol\n");
+            printf("Invalid option %s\n", argv[i]);
             exit(0);
         }
     }
 
-    pFile = fopen (fname,"r");
-    if(pFile == 0)
-    {   
-        printf("Trace file problem\n");
+    if(protocol >= numProtocols) {
+        printf("Invalid protocol\n");
         exit(0);
     }
-    
-    ulong proc;
-    char op;
-    ulong addr;
 
-    int line = 1;
-    while(fscanf(pFile, "%lu %c %lx", &proc, &op, &addr) != EOF)
+    SimConfig config;
+    config.cache_size = cache_size;
+    config.cache_assoc = cache_assoc;
+    config.blk_size = blk_size;
+    config.num_processors = num_processors;
+    config.protocol = protocol;
+    config.prefetch = prefetch;
+    config.prefetchDegree = prefetchDegree;
+    config.trace = fname;
+
+    TraceGenerator gen;
+    TraceReader reader;
+    TraceMerger merger;
+    vector<string> mergeFiles;
+    TraceSource *source;
+    if(strncmp(fname, "gen:", 4) == 0)
     {
-#ifdef _DEBUG
-        printf("%d\n", line);
-#endif
-        // propagate request down through memory hierarchy
-        // by calling cachesArray[processor#]->Access(...)
-        busRequestType broadcastBusReq = BUS_REQ_MAX;
-        if(proc < num_processors) {
-            broadcastBusReq = cacheArray[proc]->Access(addr, op);
-        } else {
-            printf("Invalid processor number");
+        // synthetic workload, generated in memory and fed batch by batch
+        if(!gen.configure(fname + 4, num_processors, blk_size))
+        {
+            printf("Invalid generator spec\n");
+            exit(0);
         }
+        source = &gen;
+    }
+    else if(strncmp(fname, "merge:", 6) == 0)
+    {
+        // one file per core, interleaved by timestamp as we go
+        if(!TraceMerger::splitSpec(fname + 6, mergeFiles) || mergeFiles.size() > num_processors)
+        {
+            printf("Invalid merge spec\n");
+            exit(0);
+        }
+        if(!merger.open(mergeFiles, mergeTies))
+        {
+            printf("Trace file problem\n");
+            exit(0);
+        }
+        if(merger.mixedTimestamps)
+        {
+            fprintf(stderr, "some merge inputs have no timestamps, interleaving round-robin\n");
+        }
+        source = &merger;
+    }
+    else
+    {
+        if(!reader.open(fname))
+        {
+            printf("Trace file problem\n");
+            exit(0);
+        }
+        source = &reader;
+    }
 
-        bool LineStatus = false;
-        bool FlushOptCheck = false;
-        for(int i=0;i<(int)num_processors;i++) {
-            bool tempLineStatus = false;
-            busRequestType tempBusReq = BUS_REQ_MAX;
-            if(i != (int)proc) {
-                tempBusReq = cacheArray[i]->snoop(addr,broadcastBusReq,tempLineStatus);
-            }
-            if(protocol >= 2)
-            {
-                LineStatus |= tempLineStatus;
-                if(tempBusReq == BUS_REQ_FLUSH)
-                {
-                    FlushOptCheck = true;
+    if(format == STATS_TEXT) {
+        printConfig(config);
+    }
+    // print out simulator configuration here
+
+    ResultCache results;
+    string resultKey;
+    if(resultDir != NULL) {
+        string traceId;
+        if(!ResultCache::revision()[0]) {
+            fprintf(stderr, "build has no clean git revision, running uncached\n");
+        } else if(!results.open(resultDir)) {
+            fprintf(stderr, "result cache %s unusable, running uncached\n", resultDir);
+        } else if(source == &gen) {
+            traceId = "gen:" + gen.describe();
+        } else if(source == &merger) {
+            traceId = merger.roundRobin ? "merge:rr" : (mergeTies ? "merge:ties" : "merge:heap");
+            for(ulong k = 0; k < mergeFiles.size(); k++) {
+                string digest;
+                if(!results.traceDigest(mergeFiles[k].c_str(), digest)) {
+                    fprintf(stderr, "merge input %s is not a regular file, running uncached\n",
+                            mergeFiles[k].c_str());
+                    traceId.clear();
+                    break;
                 }
+                traceId += "," + digest;
             }
+        } else if(!results.traceDigest(fname, traceId)) {
+            fprintf(stderr, "trace is not a regular file, running uncached\n");
         }
-
-        if(protocol >= 2)
-        {
-            if(!LineStatus && (op == 'r') && (broadcastBusReq == BUS_REQ_READ))
-            {
-                cacheLine *line = cacheArray[proc]->findLine(addr);
-                line->setFlags(STATE_EXCLUSIVE);
-            }
-            if(FlushOptCheck)
-            {
-                cacheArray[proc]->ct_cache_to_cache_transfers++;
-            }
-            if(!FlushOptCheck && ((broadcastBusReq == BUS_REQ_READ) || (broadcastBusReq == BUS_REQ_READX)))
-            {
-                cacheArray[proc]->ct_memory_transactions++;
+        if(!traceId.empty()) {
+            const char *formatName[] = {"text", "json", "csv"};
+            string extra = string("format=") + formatName[format];
+            // json embeds the trace name, a renamed copy must not replay the old one
+            if(format == STATS_JSON) {
+                extra += ";name=" + config.trace;
             }
+            resultKey = results.makeKey(config, traceId, extra);
         }
-        line++;
     }
 
-    fclose(pFile);
+    // interval, progress, profile and check output only exist if we simulate
+    string stored;
+    if(!resultKey.empty() && intervalFile == NULL && !progress && !profile && !checkRate &&
+       results.lookup(resultKey, stored)) {
+        fwrite(stored.data(), 1, stored.size(), stdout);
+        return 0;
+    }
+    
+    Simulator sim;
+    if(!sim.configure(config)) {
+        printf("Invalid cache configuration: size %lu, assoc %lu, block size %lu, %lu processors\n",
+               config.cache_size, config.cache_assoc, config.blk_size, config.num_processors);
+        exit(0);
+    }
+    sim.setCheckRate(checkRate);
 
-    //********************************//
-    //print out all caches' statistics //
-    //********************************//
-    for(int i=0;i<(int)num_processors;i++) {
-        printf("============ Simulation results (Cache %d) ============\n",i);
-        cacheArray[i]->printStats();
-        if(protocol == 3)
-        {
-            cout << "14. number of useful snoops: " << ((MESI_Snoop_Filter_Cache *)cacheArray[i])->ct_snoop_filter_useful << endl;
-            cout << "15. number of wasted snoops: " << ((MESI_Snoop_Filter_Cache *)cacheArray[i])->ct_snoop_filter_wasted << endl;
-            cout << "16. number of filtered snoops: " << ((MESI_Snoop_Filter_Cache *)cacheArray[i])->ct_snoop_filter_filtered << endl;
+    IntervalWriter intervals;
+    if(intervalFile != NULL && !intervals.open(intervalFile, interval, sim.getCaches(), sim.getNumCaches())) {
+        printf("Interval file problem\n");
+        exit(0);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = requestStop;
+    sa.sa_flags = SA_RESETHAND;     // no SA_RESTART: a blocked read on a pipe returns
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    ulong nextProgress = progress ? progress : ~0UL;
+    double startSecs = wallSecs();
+    if(profile) {
+        profStart();
+    }
+
+    TraceRecord batch[4096];
+    ulong n;
+    while(!stopRequested && (n = readRecords(source, batch, 4096)) != 0)
+    {
+        for(ulong i = 0; i < n; ) {
+            // split the batch at interval boundaries
+            ulong chunk = min(n - i, intervals.nextSample - sim.getAccesses());
+#ifdef _DEBUG
+            chunk = 1;
+            printf("%lu\n", sim.getAccesses() + 1);
+#endif
+            sim.step(batch + i, chunk);
+            i += chunk;
+            if(sim.getAccesses() == intervals.nextSample) intervals.sample(sim.getAccesses());
+        }
+        if(sim.getAccesses() >= nextProgress) {
+            printProgress(stderr, sim.getCaches(), sim.getNumCaches(), sim.getAccesses(), wallSecs() - startSecs);
+            nextProgress = sim.getAccesses() - sim.getAccesses() % progress + progress;
         }
     }
-    
+    if(stopRequested) {
+        fprintf(stderr, "interrupted after %lu accesses\n", sim.getAccesses());
+    }
+    if(sim.getBadProcs()) {
+        fprintf(stderr, "skipped %lu records with an invalid processor number\n", sim.getBadProcs());
+    }
+    ulong badRecords = reader.badRecords + merger.badRecords();
+    if(badRecords) {
+        fprintf(stderr, "skipped %lu malformed trace records\n", badRecords);
+    }
+    reader.close();
+    merger.close();
+
+    intervals.close(sim.getAccesses());
+    if(profile) {
+        profReport(stderr, sim.getAccesses());
+    }
+    if(checkRate > 0) {
+        printCheckReport(stderr, sim);
+    }
+
+    if(!resultKey.empty() && !stopRequested) {
+        char *text = NULL;
+        size_t len = 0;
+        FILE *mem = open_memstream(&text, &len);
+        printAllStats(mem, format, sim);
+        fclose(mem);
+        fwrite(text, 1, len, stdout);
+        if(!results.store(resultKey, string(text, len))) {
+            fprintf(stderr, "could not store result in %s\n", resultDir);
+        }
+        free(text);
+    } else {
+        printAllStats(stdout, format, sim);
+    }
+    // a failed check fails the run, for scripts
+    return sim.getViolations() != 0;
 }
@@ -0,0 +1,166 @@
+/*******************************************************
+                          merge.cc
+********************************************************/
+
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include "merge.h"
+using namespace std;
+
+// per-file read buffer, a hundred cores stay well under the single-file 1MB
+static const ulong MERGE_BUFFER_BYTES = 256 << 10;
+
+TraceMerger::TraceMerger()
+{
+    later.tieBreak = false;
+    roundRobin = false;
+    mixedTimestamps = false;
+}
+
+TraceMerger::~TraceMerger()
+{
+    close();
+}
+
+bool TraceMerger::splitSpec(const char *spec, vector<string> &files)
+{
+    files.clear();
+    if(spec[0] == '@') {
+        ifstream list(spec + 1);
+        if(!list) {
+            return false;
+        }
+        string line;
+        while(getline(list, line)) {
+            if(!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+            if(!line.empty()) files.push_back(line);
+        }
+    } else {
+        const char *p = spec;
+        for(;;) {
+            const char *comma = strchr(p, ',');
+            string name = comma ? string(p, comma - p) : string(p);
+            if(!name.empty()) files.push_back(name);
+            if(comma == NULL) break;
+            p = comma + 1;
+        }
+    }
+    return !files.empty();
+}
+
+/*read file core's next record; false at its end or when interrupted*/
+bool TraceMerger::load(ulong core, headRecord &head, bool &timed)
+{
+    if(!readers[core]->nextCoreRecord(core, head.rec, head.stamp, timed)) {
+        return false;
+    }
+    if(roundRobin) {
+        head.stamp = taken[core];
+    } else if(timed) {
+        lastStamp[core] = head.stamp;
+    } else {
+        head.stamp = lastStamp[core];
+    }
+    return true;
+}
+
+/*queue the next record of file core, false if a read was interrupted*/
+bool TraceMerger::advance(ulong core)
+{
+    headRecord head;
+    bool timed;
+    if(load(core, head, timed)) {
+        heap.push_back(head);
+        push_heap(heap.begin(), heap.end(), later);
+        return true;
+    }
+    if(!readers[core]->finished()) {
+        pending.push_back(core);
+        return false;
+    }
+    return true;
+}
+
+bool TraceMerger::open(const vector<string> &files, bool deterministicTies)
+{
+    close();
+    for(ulong k = 0; k < files.size(); k++) {
+        TraceReader *r = new TraceReader(MERGE_BUFFER_BYTES);
+        readers.push_back(r);
+        if(!r->open(files[k].c_str())) {
+            close();
+            return false;
+        }
+    }
+    lastStamp.assign(files.size(), 0);
+    taken.assign(files.size(), 0);
+    roundRobin = false;
+
+    // the first record of every file decides between timestamps and round-robin
+    vector<headRecord> first(readers.size());
+    vector<bool> present(readers.size(), false);
+    ulong liveFiles = 0, timedFiles = 0;
+    for(ulong k = 0; k < readers.size(); k++) {
+        bool timed = false;
+        while(!(present[k] = load(k, first[k], timed)) && !readers[k]->finished()) {
+            /*interrupted before the run started, retry*/
+        }
+        if(present[k]) {
+            liveFiles++;
+            if(timed) timedFiles++;
+        }
+    }
+    roundRobin = (timedFiles < liveFiles);
+    mixedTimestamps = roundRobin && (timedFiles > 0);
+    // round-robin is a merge on the per-file record count, ties by file
+    later.tieBreak = deterministicTies || roundRobin;
+
+    for(ulong k = 0; k < readers.size(); k++) {
+        if(!present[k]) continue;
+        if(roundRobin) first[k].stamp = 0;
+        heap.push_back(first[k]);
+    }
+    make_heap(heap.begin(), heap.end(), later);
+    return true;
+}
+
+void TraceMerger::close()
+{
+    for(ulong k = 0; k < readers.size(); k++) {
+        delete readers[k];
+    }
+    readers.clear();
+    heap.clear();
+    pending.clear();
+}
+
+ulong TraceMerger::fill(TraceRecord *recs, ulong n)
+{
+    // the merge order is unknown until an interrupted refill completes
+    while(!pending.empty()) {
+        ulong core = pending.back();
+        pending.pop_back();
+        if(!advance(core)) return 0;
+    }
+
+    ulong got = 0;
+    while(got < n && !heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), later);
+        ulong core = heap.back().rec.proc;
+        recs[got++] = heap.back().rec;
+        heap.pop_back();
+        taken[core]++;
+        if(!advance(core)) break;
+    }
+    return got;
+}
+
+ulong TraceMerger::badRecords()
+{
+    ulong bad = 0;
+    for(ulong k = 0; k < readers.size(); k++) {
+        bad += readers[k]->badRecords;
+    }
+    return bad;
+}
@@ -0,0 +1,63 @@
+/*******************************************************
+                          merge.h
+********************************************************/
+
+#ifndef MERGE_H
+#define MERGE_H
+
+#include <string>
+#include <vector>
+#include "sim.h"
+#include "trace.h"
+
+/*Interleaves per-core trace files on the fly. File k holds the records of
+  processor k as "[<decimal timestamp>] <op> <hex addr>", each file has its
+  own small buffered reader and a binary heap on the head records yields
+  them in timestamp order, one file's refill at a time, so nothing is
+  sorted or held in memory beyond one record per file.
+  Equal timestamps come out in heap order unless tie-breaking is asked for,
+  then by file index. If any file has no timestamps the merge falls back to
+  round-robin: one record per file in turn, exhausted files drop out.*/
+class TraceMerger: public TraceSource
+{
+protected:
+   struct headRecord {
+      ulong stamp;
+      TraceRecord rec;
+   };
+
+   /*heap order, the earliest record on top*/
+   struct laterHead {
+      bool tieBreak;
+      bool operator()(const headRecord &a, const headRecord &b) const {
+         if(a.stamp != b.stamp) return a.stamp > b.stamp;
+         return tieBreak && a.rec.proc > b.rec.proc;
+      }
+   };
+
+   std::vector<TraceReader *> readers;
+   std::vector<headRecord> heap;
+   laterHead later;
+   std::vector<ulong> lastStamp;  /*inherited by untimestamped lines of a timestamped file*/
+   std::vector<ulong> taken;      /*records merged per file, the round-robin clock*/
+   std::vector<ulong> pending;    /*files whose next record an interrupted read still owes*/
+
+   bool load(ulong core, headRecord &head, bool &timed);
+   bool advance(ulong core);
+
+public:
+   bool roundRobin;
+   bool mixedTimestamps;          /*some files are timestamped, others are not*/
+
+   TraceMerger();
+   ~TraceMerger();
+   /*files are given as "f0,f1,..." or "@list" with one path per line; file
+     k feeds processor k*/
+   static bool splitSpec(const char *spec, std::vector<std::string> &files);
+   bool open(const std::vector<std::string> &files, bool deterministicTies);
+   void close();
+   ulong fill(TraceRecord *recs, ulong n);
+   ulong badRecords();
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*******************************************************
+                          prefetch.cc
+********************************************************/
+
+#include <stdlib.h>
+#include "prefetch.h"
+using namespace std;
+
+const char *prefetchName[PREFETCH_MAX] = {"none", "next", "stride", "stream"};
+
+static const ulong STRIDE_TABLE_SIZE = 16;
+static const ulong STRIDE_REGION_BITS = 12;
+static const ulong STRIDE_CONFIRM = 2;
+static const ulong STREAM_TABLE_SIZE = 8;
+static const long STREAM_WINDOW = 4;     /*blocks a miss may be from its stream*/
+
+Prefetcher::Prefetcher(ulong blk_size, ulong deg)
+{
+    blkSize = blk_size;
+    log2Blk = (ulong)(log2(blk_size));
+    degree = deg;
+}
+
+void NextLinePrefetcher::observe(ulong addr, bool trigger, vector<ulong> &candidates)
+{
+    if(!trigger) return;
+    ulong block = addr >> log2Blk;
+    for(ulong k = 1; k <= degree; k++) {
+        candidates.push_back((block + k) << log2Blk);
+    }
+}
+
+StridePrefetcher::StridePrefetcher(ulong blk_size, ulong deg): Prefetcher(blk_size, deg)
+{
+    reset();
+}
+
+void StridePrefetcher::reset()
+{
+    strideEntry empty = {~0UL, 0, 0, 0};
+    table.assign(STRIDE_TABLE_SIZE, empty);
+}
+
+void StridePrefetcher::observe(ulong addr, bool trigger, vector<ulong> &candidates)
+{
+    ulong block = addr >> log2Blk;
+    ulong region = addr >> STRIDE_REGION_BITS;
+    strideEntry &e = table[region % STRIDE_TABLE_SIZE];
+
+    if(e.region != region) {
+        e.region = region;
+        e.lastBlock = block;
+        e.stride = 0;
+        e.confidence = 0;
+        return;
+    }
+    long stride = (long)(block - e.lastBlock);
+    if(stride == 0) return;
+    if(stride == e.stride) {
+        if(e.confidence < STRIDE_CONFIRM) e.confidence++;
+    } else {
+        e.stride = stride;
+        e.confidence = 0;
+    }
+    e.lastBlock = block;
+
+    if(e.confidence >= STRIDE_CONFIRM) {
+        for(ulong k = 1; k <= degree; k++) {
+            candidates.push_back((block + e.stride * (long)k) << log2Blk);
+        }
+    }
+}
+
+StreamPrefetcher::StreamPrefetcher(ulong blk_size, ulong deg): Prefetcher(blk_size, deg)
+{
+    reset();
+}
+
+void StreamPrefetcher::reset()
+{
+    streamEntry empty = {false, 0, 0, 0};
+    streams.assign(STREAM_TABLE_SIZE, empty);
+    nextVictim = 0;
+}
+
+void StreamPrefetcher::observe(ulong addr, bool trigger, vector<ulong> &candidates)
+{
+    if(!trigger) return;
+    ulong block = addr >> log2Blk;
+
+    for(ulong i = 0; i < streams.size(); i++) {
+        streamEntry &s = streams[i];
+        long delta = (long)(block - s.lastBlock);
+        if(!s.valid || delta == 0 || labs(delta) > STREAM_WINDOW) continue;
+
+        long direction = (delta > 0) ? 1 : -1;
+        if(direction == s.direction) {
+            s.hits++;
+        } else {
+            s.direction = direction;
+            s.hits = 0;
+        }
+        s.lastBlock = block;
+        if(s.hits >= 1) {
+            for(ulong k = 1; k <= degree; k++) {
+                candidates.push_back((block + s.direction * (long)k) << log2Blk);
+            }
+        }
+        return;
+    }
+
+    streamEntry &s = streams[nextVictim];
+    nextVictim = (nextVictim + 1) % streams.size();
+    s.valid = true;
+    s.lastBlock = block;
+    s.direction = 0;
+    s.hits = 0;
+}
+
+Prefetcher *createPrefetcher(prefetchKind kind, ulong blk_size, ulong degree)
+{
+    switch(kind) {
+        case PREFETCH_NEXT_LINE: return new NextLinePrefetcher(blk_size, degree);
+        case PREFETCH_STRIDE:    return new StridePrefetcher(blk_size, degree);
+        case PREFETCH_STREAM:    return new StreamPrefetcher(blk_size, degree);
+        default:                 return NULL;
+    }
+}
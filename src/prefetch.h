@@ -0,0 +1,85 @@
+/*******************************************************
+                          prefetch.h
+********************************************************/
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <vector>
+#include "cache.h"
+
+enum prefetchKind {
+    PREFETCH_NONE = 0,
+    PREFETCH_NEXT_LINE,
+    PREFETCH_STRIDE,
+    PREFETCH_STREAM,
+    PREFETCH_MAX
+};
+
+/*Hardware prefetcher attached to one cache. It sees every demand access and
+  proposes block addresses to fetch; the simulator issues each one as a
+  BUS_REQ_READ through the normal snoop broadcast. `trigger` is set for
+  demand misses and for the first demand hit on a prefetched line.*/
+class Prefetcher
+{
+protected:
+   ulong blkSize, log2Blk, degree;
+public:
+   Prefetcher(ulong blk_size, ulong deg);
+   virtual ~Prefetcher() {}
+   virtual void observe(ulong addr, bool trigger, std::vector<ulong> &candidates) = 0;
+   /*forget all learnt state, tables keep their storage*/
+   virtual void reset() {}
+};
+
+/*fetch the next `degree` blocks after a triggering access*/
+class NextLinePrefetcher: public Prefetcher
+{
+public:
+   NextLinePrefetcher(ulong blk_size, ulong deg): Prefetcher(blk_size, deg) {}
+   void observe(ulong addr, bool trigger, std::vector<ulong> &candidates);
+};
+
+/*IP-less stride detection: traces carry no PC, so strides are learnt per
+  4KB region and confirmed twice before prefetching*/
+class StridePrefetcher: public Prefetcher
+{
+protected:
+   struct strideEntry {
+      ulong region;
+      ulong lastBlock;
+      long stride;
+      ulong confidence;
+   };
+   std::vector<strideEntry> table;
+public:
+   StridePrefetcher(ulong blk_size, ulong deg);
+   void reset();
+   void observe(ulong addr, bool trigger, std::vector<ulong> &candidates);
+};
+
+/*tracks a few ascending/descending miss streams and runs `degree` blocks
+  ahead of each once its direction has been seen twice*/
+class StreamPrefetcher: public Prefetcher
+{
+protected:
+   struct streamEntry {
+      bool valid;
+      ulong lastBlock;
+      long direction;
+      ulong hits;
+   };
+   std::vector<streamEntry> streams;
+   ulong nextVictim;
+public:
+   StreamPrefetcher(ulong blk_size, ulong deg);
+   void reset();
+   void observe(ulong addr, bool trigger, std::vector<ulong> &candidates);
+};
+
+extern const char *prefetchName[PREFETCH_MAX];
+
+/*NULL for PREFETCH_NONE*/
+Prefetcher *createPrefetcher(prefetchKind kind, ulong blk_size, ulong degree);
+
+#endif
@@ -0,0 +1,55 @@
+/*******************************************************
+                          profile.cc
+********************************************************/
+
+#include "profile.h"
+
+bool profEnabled = false;
+ulong profTicks[PROF_MAX];
+ulong profCalls[PROF_MAX];
+
+static const char *profPhaseName[PROF_MAX] = {
+    "trace read/parse", "Access", "snoop broadcast", "findLine",
+    "fillLine/getLRU", "post-snoop fix-up", "invariant check"
+};
+
+static ulong startTicks;
+static double startSecs;
+
+static double wallSecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void profStart()
+{
+    for(int i = 0; i < PROF_MAX; i++) {
+        profTicks[i] = profCalls[i] = 0;
+    }
+    profEnabled = true;
+    startSecs = wallSecs();
+    startTicks = profNow();
+}
+
+void profReport(FILE *out, ulong accesses)
+{
+    ulong totalTicks = profNow() - startTicks;
+    double secs = wallSecs() - startSecs;
+    /*ticks are TSC cycles on x86, calibrate them against the wall clock*/
+    double ticksPerSec = (secs > 0) ? totalTicks / secs : 1;
+
+    fprintf(out, "===== Simulator profile =====\n");
+    fprintf(out, "%-20s %14s %12s %8s %10s\n", "phase", "calls", "seconds", "%", "ns/call");
+    for(int i = 0; i < PROF_MAX; i++) {
+        double s = profTicks[i] / ticksPerSec;
+        fprintf(out, "%-20s %14lu %12.6f %7.2f%% %10.1f\n", profPhaseName[i], profCalls[i], s,
+                totalTicks ? 100.0 * profTicks[i] / totalTicks : 0.0,
+                profCalls[i] ? s * 1e9 / profCalls[i] : 0.0);
+    }
+    fprintf(out, "%-20s %14s %12.6f\n", "total", "", secs);
+    fprintf(out, "accesses: %lu\n", accesses);
+    fprintf(out, "accesses/second: %.0f\n", secs > 0 ? accesses / secs : 0.0);
+    fprintf(out, "(findLine and fillLine/getLRU are also included in Access and snoop broadcast)\n");
+}
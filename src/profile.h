@@ -0,0 +1,73 @@
+/*******************************************************
+                          profile.h
+********************************************************/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+typedef unsigned long ulong;
+
+/*phases of the simulator itself. findLine and fillLine are nested inside
+  Access and the snoop broadcast, so their time is also counted there*/
+enum profPhase {
+    PROF_TRACE_READ = 0,
+    PROF_ACCESS,
+    PROF_SNOOP,
+    PROF_FIND_LINE,
+    PROF_FILL_LINE,
+    PROF_FIXUP,
+    PROF_CHECK,
+    PROF_MAX
+};
+
+extern bool profEnabled;
+extern ulong profTicks[PROF_MAX];
+extern ulong profCalls[PROF_MAX];
+
+/*cheapest monotonic tick source available: the TSC on x86, ns otherwise*/
+static inline ulong profNow()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#endif
+}
+
+/*times the enclosing scope; costs one predictable branch when disabled*/
+class ProfScope
+{
+   profPhase phase;
+   ulong start;
+public:
+   ProfScope(profPhase p) : phase(p), start(0) {
+      if(__builtin_expect(profEnabled, 0)) start = profNow();
+   }
+   ~ProfScope() {
+      if(__builtin_expect(profEnabled, 0)) {
+         profTicks[phase] += profNow() - start;
+         profCalls[phase]++;
+      }
+   }
+};
+
+/*build with -DSMP_NO_PROFILE to compile the probes out entirely*/
+#ifdef SMP_NO_PROFILE
+#define PROF_SCOPE(phase)
+#else
+#define PROF_SCOPE(phase) ProfScope profScope_(phase)
+#endif
+
+void profStart();
+/*phase breakdown and accesses/second since profStart()*/
+void profReport(FILE *out, ulong accesses);
+
+#endif
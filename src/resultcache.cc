@@ -0,0 +1,162 @@
+/*******************************************************
+                          resultcache.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "resultcache.h"
+using namespace std;
+
+// set by the Makefile from git describe, which marks local changes -dirty
+#ifndef SMP_GIT_REV
+#define SMP_GIT_REV "unknown"
+#endif
+
+/*two independent 64-bit FNV-1a style lanes, 128 bits of key*/
+struct hash128
+{
+    ulong a, b;
+    hash128() : a(0xcbf29ce484222325UL), b(0x84222325cbf29ce4UL) {}
+    void add(const char *p, size_t n) {
+        for(size_t i = 0; i < n; i++) {
+            a = (a ^ (uchar)p[i]) * 0x100000001b3UL;
+            b = (b ^ (uchar)p[i]) * 0x9E3779B97F4A7C15UL;
+        }
+    }
+    void add(const string &s) { add(s.data(), s.size()); }
+    string hex() {
+        char buf[33];
+        snprintf(buf, sizeof(buf), "%016lx%016lx", a, b);
+        return string(buf);
+    }
+};
+
+static bool readFile(const string &path, string &data)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    data.clear();
+    char buf[1 << 16];
+    ssize_t got;
+    while((got = read(fd, buf, sizeof(buf))) > 0) {
+        data.append(buf, got);
+    }
+    ::close(fd);
+    return got == 0;
+}
+
+/*write to a temporary file next to the target and rename it into place*/
+static bool writeFileAtomic(const string &path, const string &data)
+{
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), ".tmp.%ld.%lx", (long)getpid(), (ulong)random());
+    string tmpPath = path + tmp;
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if(fd < 0) return false;
+
+    const char *p = data.data();
+    size_t left = data.size();
+    bool ok = true;
+    while(left > 0) {
+        ssize_t put = write(fd, p, left);
+        if(put < 0) {
+            if(errno == EINTR) continue;
+            ok = false;
+            break;
+        }
+        p += put;
+        left -= put;
+    }
+    ok = ok && (fsync(fd) == 0);
+    ok = (::close(fd) == 0) && ok;
+    if(ok && rename(tmpPath.c_str(), path.c_str()) == 0) {
+        return true;
+    }
+    unlink(tmpPath.c_str());
+    return false;
+}
+
+const char *ResultCache::revision()
+{
+    const char *rev = SMP_GIT_REV;
+    size_t len = strlen(rev);
+    if(strcmp(rev, "unknown") == 0 || (len >= 6 && strcmp(rev + len - 6, "-dirty") == 0)) {
+        return "";
+    }
+    return rev;
+}
+
+bool ResultCache::open(const char *directory)
+{
+    dir = directory;
+    if(mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    struct stat st;
+    return stat(directory, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool ResultCache::traceDigest(const char *fname, string &digest)
+{
+    struct stat st;
+    if(strcmp(fname, "-") == 0 || stat(fname, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    char id[256];
+    snprintf(id, sizeof(id), "%lu:%lu:%ld:%ld.%09ld", (ulong)st.st_dev, (ulong)st.st_ino,
+             (long)st.st_size, (long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+    hash128 memoKey;
+    memoKey.add(id, strlen(id));
+    string memoPath = dir + "/trace-" + memoKey.hex();
+    if(readFile(memoPath, digest) && digest.size() == 32) {
+        return true;
+    }
+
+    int fd = ::open(fname, O_RDONLY);
+    if(fd < 0) return false;
+    hash128 h;
+    char *buf = new char[1 << 20];
+    ssize_t got;
+    while((got = read(fd, buf, 1 << 20)) > 0) {
+        h.add(buf, got);
+    }
+    delete [] buf;
+    ::close(fd);
+    if(got < 0) return false;
+
+    digest = h.hex();
+    writeFileAtomic(memoPath, digest);
+    return true;
+}
+
+string ResultCache::makeKey(const SimConfig &config, const string &traceId, const string &extra)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "revision=%s;size=%lu;assoc=%lu;blk=%lu;procs=%lu;protocol=%lu;"
+             "filter=%d/%d/%d;prefetch=%s:%lu;",
+             revision(), config.cache_size, config.cache_assoc, config.blk_size,
+             config.num_processors, config.protocol,
+             SNOOP_FILTER_SIZE, SNOOP_FILTER_ASSOC, SNOOP_FILTER_BLOCK,
+             prefetchName[config.prefetch], config.prefetchDegree);
+    hash128 h;
+    h.add(string(buf));
+    h.add("trace=" + traceId + ";" + extra);
+    return h.hex();
+}
+
+bool ResultCache::lookup(const string &key, string &result)
+{
+    return readFile(dir + "/" + key + ".result", result);
+}
+
+bool ResultCache::store(const string &key, const string &result)
+{
+    return writeFileAtomic(dir + "/" + key + ".result", result);
+}
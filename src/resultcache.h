@@ -0,0 +1,41 @@
+/*******************************************************
+                          resultcache.h
+********************************************************/
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <string>
+#include "sim.h"
+
+/*On-disk store of finished runs, one file per result named by a 128-bit
+  hash of the source revision the engine was built from, the full
+  configuration and the trace contents. Results are written to a private temporary file and renamed
+  into place, so parallel runs sharing a directory only ever see complete
+  entries; two runs racing on the same key write identical bytes.*/
+class ResultCache
+{
+protected:
+   std::string dir;
+
+public:
+   /*git revision of the build, "" when a dirty or non-git tree leaves the
+     engine's sources unidentified and results must not be reused*/
+   static const char *revision();
+
+   bool open(const char *directory);
+
+   /*digest of a regular file's contents, memoized per path/inode/size/mtime
+     so a large trace is read only once; false for pipes and stdin*/
+   bool traceDigest(const char *fname, std::string &digest);
+
+   /*traceId identifies the records (a file digest or a generator spec),
+     extra anything else that changes the stored bytes, e.g. the format*/
+   std::string makeKey(const SimConfig &config, const std::string &traceId,
+                       const std::string &extra);
+
+   bool lookup(const std::string &key, std::string &result);
+   bool store(const std::string &key, const std::string &result);
+};
+
+#endif
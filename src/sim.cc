@@ -0,0 +1,459 @@
+/*******************************************************
+                          sim.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "sim.h"
+#include "profile.h"
+using namespace std;
+
+const char *protocolName[] = {"MSI", "MSI BusUpgr", "MESI", "MESI Filter", "Dragon", "Firefly"};
+const ulong numProtocols = sizeof(protocolName) / sizeof(protocolName[0]);
+const char *stateName[STATE_MAX] = {"I", "M", "O", "E", "S", "Sc", "Sm"};
+
+// fixed seed of the check sampling, runs are reproducible
+static const ulong CHECK_SEED = 0x9E3779B97F4A7C15UL;
+
+Cache *createCache(ulong proto, ulong cache_size, ulong cache_assoc, ulong blk_size)
+{
+    if(proto == 0) {
+        return new MSI_Cache(cache_size, cache_assoc, blk_size);
+    } else if (proto == 1) {
+        return new MSI_BusUpgr_Cache(cache_size, cache_assoc, blk_size);
+    } else if (proto == 2) {
+        return new MESI_Cache(cache_size, cache_assoc, blk_size);
+    } else if (proto == 3) {
+        return new MESI_Snoop_Filter_Cache(cache_size, cache_assoc, blk_size);
+    } else if (proto == 4) {
+        return new Dragon_Cache(cache_size, cache_assoc, blk_size);
+    } else if (proto == 5) {
+        return new Firefly_Cache(cache_size, cache_assoc, blk_size);
+    }
+    return NULL;
+}
+
+Simulator::Simulator()
+{
+    cacheArray = NULL;
+    numCaches = 0;
+    accesses = 0;
+    badProcs = 0;
+    checkRate = 0;
+    nextCheck = ULONG_MAX;
+    checkSeed = CHECK_SEED;
+    checks = 0;
+    violations = 0;
+}
+
+Simulator::~Simulator()
+{
+    freeCaches();
+}
+
+void Simulator::freeCaches()
+{
+    for(ulong i = 0; i < numCaches; i++) {
+        delete cacheArray[i];
+    }
+    delete [] cacheArray;
+    cacheArray = NULL;
+    numCaches = 0;
+}
+
+static inline bool powerOfTwo(ulong x)
+{
+    return x != 0 && (x & (x - 1)) == 0;
+}
+
+/*Cache indexes sets and tags with shifts and divides by block and
+  associativity, so every one of them must be a nonzero power of two*/
+static bool validGeometry(const SimConfig &config)
+{
+    if(!powerOfTwo(config.blk_size) || !powerOfTwo(config.cache_assoc) ||
+       config.cache_size > INT_MAX) {
+        return false;
+    }
+    ulong setBytes = config.blk_size * config.cache_assoc;
+    if(setBytes > config.cache_size || config.cache_size % setBytes != 0) {
+        return false;
+    }
+    return powerOfTwo(config.cache_size / setBytes);
+}
+
+bool Simulator::configure(const SimConfig &newConfig)
+{
+    bool sameGeometry = (cacheArray != NULL) &&
+        newConfig.cache_size == config.cache_size && newConfig.cache_assoc == config.cache_assoc &&
+        newConfig.blk_size == config.blk_size && newConfig.num_processors == config.num_processors &&
+        newConfig.protocol == config.protocol && newConfig.prefetch == config.prefetch &&
+        newConfig.prefetchDegree == config.prefetchDegree;
+    config = newConfig;
+    if(sameGeometry) {
+        reset();
+        return true;
+    }
+
+    freeCaches();
+    if(config.protocol >= numProtocols || config.num_processors == 0 || !validGeometry(config)) {
+        return false;
+    }
+    // Using pointers so that we can use inheritance */
+    cacheArray = new Cache*[config.num_processors];
+    for(ulong i = 0; i < config.num_processors; i++) {
+        cacheArray[i] = createCache(config.protocol, config.cache_size, config.cache_assoc, config.blk_size);
+        if(cacheArray[i] == NULL) {
+            freeCaches();
+            return false;
+        }
+        numCaches++;
+        cacheArray[i]->prefetcher = createPrefetcher(config.prefetch, config.blk_size, config.prefetchDegree);
+    }
+    reset();
+    return true;
+}
+
+void Simulator::reset()
+{
+    for(ulong i = 0; i < numCaches; i++) {
+        cacheArray[i]->reset();
+    }
+    lockStats.clear();
+    accesses = 0;
+    badProcs = 0;
+    checkSeed = CHECK_SEED;
+    checks = 0;
+    violations = 0;
+    scheduleCheck();
+}
+
+void Simulator::setCheckRate(double rate)
+{
+    checkRate = rate;
+    scheduleCheck();
+}
+
+/*geometric gaps, each record is checked with probability rate*/
+void Simulator::scheduleCheck()
+{
+    if(checkRate <= 0) {
+        nextCheck = ULONG_MAX;
+        return;
+    }
+    double gap = 1;
+    if(checkRate < 1) {
+        checkSeed ^= checkSeed << 13;
+        checkSeed ^= checkSeed >> 7;
+        checkSeed ^= checkSeed << 17;
+        double u = ((checkSeed >> 11) + 1) * (1.0 / 9007199254740992.0);   /*(0, 1]*/
+        gap = 1 + floor(log(u) / log(1 - checkRate));
+    }
+    nextCheck = (gap < (double)(ULONG_MAX - accesses)) ? accesses + (ulong)gap : ULONG_MAX;
+}
+
+/*check the coherence invariants of addr's line across all caches*/
+void Simulator::checkLine(const TraceRecord &rec, ulong addr)
+{
+    ulong valid = 0, exclusive = 0, owners = 0;
+    bool filterHit = false;
+    for(ulong i = 0; i < numCaches; i++) {
+        cacheLine *line = cacheArray[i]->findLine(addr);
+        if(line == NULL) continue;
+        valid++;
+        ulong state = line->getFlags();
+        if(state == STATE_MODIFIED || state == STATE_EXCLUSIVE) exclusive++;
+        if(state == STATE_OWNED || state == STATE_SHARED_MODIFIED) owners++;
+        if(config.protocol == 3 &&
+           ((MESI_Snoop_Filter_Cache *)cacheArray[i])->SnoopFilter.findLine(addr) != NULL) {
+            filterHit = true;
+        }
+    }
+
+    const char *invariant = NULL;
+    if(exclusive > 1) {
+        invariant = "more than one M/E copy";
+    } else if(exclusive == 1 && valid > 1) {
+        invariant = "single writer with other valid copies (SWMR)";
+    } else if(owners > 1) {
+        invariant = "more than one owner (O/Sm)";
+    } else if(filterHit) {
+        invariant = "snoop filter entry for a cached line";
+    }
+    if(invariant == NULL) {
+        return;
+    }
+    if(violations++ > 0) {
+        return;
+    }
+
+    CheckViolation &v = firstViolation;
+    v.access = accesses;
+    v.rec = rec;
+    v.addr = addr;
+    v.invariant = invariant;
+    v.states.assign(numCaches, STATE_INVALID);
+    v.filtered.assign(numCaches, false);
+    for(ulong i = 0; i < numCaches; i++) {
+        cacheLine *line = cacheArray[i]->findLine(addr);
+        if(line != NULL) v.states[i] = line->getFlags();
+        if(config.protocol == 3) {
+            v.filtered[i] = ((MESI_Snoop_Filter_Cache *)cacheArray[i])->SnoopFilter.findLine(addr) != NULL;
+        }
+    }
+}
+
+/*snoop that also notices a still unused prefetched line being invalidated*/
+static busRequestType snoopPrefetched(Cache *c, ulong addr, busRequestType busReq, bool &isLinePresent)
+{
+    cacheLine *line = c->findLine(addr);
+    bool unused = (line != NULL) && line->isPrefetched();
+    busRequestType ret = c->snoop(addr, busReq, isLinePresent);
+    if(unused && !line->isValid()) {
+        c->ct_prefetch_invalidated++;
+        line->setPrefetched(false);
+    }
+    return ret;
+}
+
+/*ask the requester's prefetcher for candidates and fetch the missing ones
+  with a BusRd through the same broadcast as a demand read miss*/
+void Simulator::issuePrefetches(ulong proc, ulong addr, bool trigger)
+{
+    Cache *c = cacheArray[proc];
+
+    candidates.clear();
+    c->prefetcher->observe(addr, trigger, candidates);
+    for(ulong k = 0; k < candidates.size(); k++) {
+        ulong paddr = candidates[k];
+        if(c->findLine(paddr) != NULL) {
+            continue;
+        }
+        cacheLine *line = c->prefetchFill(paddr);
+        if(accesses == nextCheck) {
+            changedLines.push_back(paddr);
+        }
+
+        for(ulong i = 0; i < numCaches; i++) {
+            cacheLine *other = (i == proc) ? NULL : cacheArray[i]->findLine(paddr);
+            if(other != NULL && (other->getFlags() == STATE_MODIFIED || other->getFlags() == STATE_EXCLUSIVE)) {
+                c->ct_prefetch_downgrades++;
+            }
+        }
+        bool shared = false;
+        bool flushed = false;
+        broadcast(proc, paddr, BUS_REQ_READ, true, shared, flushed);
+        countLockTransaction(c, paddr);
+
+        if(config.protocol >= 2) {
+            if(!shared) {
+                line->setFlags(STATE_EXCLUSIVE);
+            }
+            if(flushed) {
+                c->ct_cache_to_cache_transfers++;
+            } else {
+                c->ct_memory_transactions++;
+            }
+        } else {
+            c->ct_memory_transactions++;
+        }
+    }
+}
+
+/*snoop busReq in every cache but proc's; LineStatus and FlushOptCheck
+  collect the shared line and whether a cache supplied the data*/
+void Simulator::broadcast(ulong proc, ulong addr, busRequestType busReq, bool prefetching,
+                          bool &LineStatus, bool &FlushOptCheck)
+{
+    PROF_SCOPE(PROF_SNOOP);
+    for(int i=0;i<(int)numCaches;i++) {
+        bool tempLineStatus = false;
+        busRequestType tempBusReq = BUS_REQ_MAX;
+        if(i != (int)proc) {
+            if(prefetching) {
+                tempBusReq = snoopPrefetched(cacheArray[i], addr, busReq, tempLineStatus);
+            } else {
+                tempBusReq = cacheArray[i]->snoop(addr,busReq,tempLineStatus);
+            }
+            // a reservation dies with the other cache's copy or with a remote write
+            if(cacheArray[i]->linkValid && cacheArray[i]->linkBlock == cacheArray[i]->blockOf(addr)) {
+                cacheLine *line = cacheArray[i]->findLine(addr);
+                if(line == NULL || !line->isValid() || busReq == BUS_REQ_UPDATE) {
+                    cacheArray[i]->linkValid = false;
+                }
+            }
+        }
+        if(config.protocol >= 2)
+        {
+            LineStatus |= tempLineStatus;
+            if(tempBusReq == BUS_REQ_FLUSH)
+            {
+                FlushOptCheck = true;
+            }
+        }
+    }
+}
+
+inline void Simulator::countLockTransaction(Cache *c, ulong addr)
+{
+    if(!lockStats.empty()) {
+        lockStatsMap::iterator it = lockStats.find(c->blockOf(addr));
+        if(it != lockStats.end()) {
+            it->second.busTransactions++;
+        }
+    }
+}
+
+/*'a', 'l' and 'c' register the line as a lock, 'c' also checks and
+  consumes the reservation; returns false for a failed store-conditional*/
+bool Simulator::syncAccess(Cache *c, ulong proc, uchar op, ulong addr)
+{
+    LockStats &ls = lockStats[c->blockOf(addr)];
+    bool acquire = (op == 'a');
+    if(op == 'c') {
+        bool held = c->linkValid && (c->linkBlock == c->blockOf(addr)) && (c->findLine(addr) != NULL);
+        c->linkValid = false;
+        if(!held) {
+            c->ct_sc_failures++;
+            ls.scFailures++;
+            return false;
+        }
+        c->ct_sc_success++;
+        acquire = true;
+    }
+    if(acquire) {
+        ls.acquires++;
+        if(ls.lastProc != ULONG_MAX && ls.lastProc != proc) {
+            ls.handoffs++;
+        }
+        ls.lastProc = proc;
+    }
+    return true;
+}
+
+void Simulator::step(const TraceRecord *recs, ulong n)
+{
+    for(ulong i = 0; i < n; i++) {
+        access(recs[i].proc, recs[i].op, recs[i].addr);
+    }
+}
+
+/*the sampled record's own line, then every other line it changed: prefetch
+  fills and the blocks of busResult's follow-up BusUpd*/
+void Simulator::checkRecord(ulong proc, uchar op, ulong addr)
+{
+    PROF_SCOPE(PROF_CHECK);
+    checks++;
+    TraceRecord rec;
+    rec.proc = proc;
+    rec.op = op;
+    rec.addr = addr;
+    checkLine(rec, addr);
+    Cache *c = cacheArray[0];
+    for(ulong k = 0; k < changedLines.size(); k++) {
+        ulong block = c->blockOf(changedLines[k]);
+        bool seen = (block == c->blockOf(addr));
+        for(ulong j = 0; j < k && !seen; j++) {
+            seen = (block == c->blockOf(changedLines[j]));
+        }
+        if(!seen) {
+            checkLine(rec, changedLines[k]);
+        }
+    }
+    changedLines.clear();
+}
+
+void Simulator::access(ulong proc, uchar op, ulong addr)
+{
+    accesses++;
+    simulate(proc, op, addr);
+    if(__builtin_expect(accesses == nextCheck, 0)) {
+        checkRecord(proc, op, addr);
+        scheduleCheck();
+    }
+}
+
+void Simulator::simulate(ulong proc, uchar op, ulong addr)
+{
+    if(proc >= numCaches) {
+        badProcs++;
+        return;
+    }
+    if(op == 'f') {
+        cacheArray[proc]->ct_fences++;
+        return;
+    }
+    // any other op is a plain read, as it always was
+    if((op == 'a' || op == 'l' || op == 'c') && !syncAccess(cacheArray[proc], proc, op, addr)) {
+        return;
+    }
+
+    bool prefetching = (cacheArray[proc]->prefetcher != NULL);
+    bool prefetchHit = false;
+    bool prefetchTrigger = false;
+    if(prefetching) {
+        cacheLine *line = cacheArray[proc]->findLine(addr);
+        prefetchTrigger = (line == NULL);
+        if(line != NULL && line->isPrefetched()) {
+            line->setPrefetched(false);
+            cacheArray[proc]->ct_prefetch_useful++;
+            prefetchHit = prefetchTrigger = true;
+        }
+    }
+
+    // propagate request down through memory hierarchy
+    // by calling cachesArray[processor#]->Access(...)
+    busRequestType broadcastBusReq;
+    {
+        PROF_SCOPE(PROF_ACCESS);
+        broadcastBusReq = cacheArray[proc]->Access(addr, op);
+    }
+    if(op == 'l') {
+        cacheArray[proc]->linkValid = true;
+        cacheArray[proc]->linkBlock = cacheArray[proc]->blockOf(addr);
+    }
+    if(broadcastBusReq != BUS_REQ_MAX) {
+        countLockTransaction(cacheArray[proc], addr);
+    }
+    if(prefetchHit && isWriteOp(op) &&
+       ((broadcastBusReq == BUS_REQ_UPGRADE) || (broadcastBusReq == BUS_REQ_READX))) {
+        cacheArray[proc]->ct_prefetch_upgrades++;
+    }
+
+    bool LineStatus = false;
+    bool FlushOptCheck = false;
+    broadcast(proc, addr, broadcastBusReq, prefetching, LineStatus, FlushOptCheck);
+
+    if(config.protocol >= 2)
+    {
+        PROF_SCOPE(PROF_FIXUP);
+        if(!LineStatus && !isWriteOp(op) && (broadcastBusReq == BUS_REQ_READ))
+        {
+            cacheLine *line = cacheArray[proc]->findLine(addr);
+            line->setFlags(STATE_EXCLUSIVE);
+        }
+        if(FlushOptCheck)
+        {
+            cacheArray[proc]->ct_cache_to_cache_transfers++;
+        }
+        if(!FlushOptCheck && ((broadcastBusReq == BUS_REQ_READ) || (broadcastBusReq == BUS_REQ_READX)))
+        {
+            cacheArray[proc]->ct_memory_transactions++;
+        }
+    }
+
+    // update protocols settle the state and may follow up with a BusUpd
+    busRequestType followUp = cacheArray[proc]->busResult(addr, op, broadcastBusReq, LineStatus);
+    if(followUp != BUS_REQ_MAX) {
+        if(accesses == nextCheck) {
+            changedLines.push_back(addr);
+        }
+        bool shared = false, flushed = false;
+        broadcast(proc, addr, followUp, prefetching, shared, flushed);
+        countLockTransaction(cacheArray[proc], addr);
+    }
+
+    if(prefetching) {
+        issuePrefetches(proc, addr, prefetchTrigger);
+    }
+}
@@ -0,0 +1,160 @@
+/*******************************************************
+                          sim.h
+********************************************************/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <limits.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cache.h"
+#include "prefetch.h"
+
+/*reported in json and bench output; the result cache keys on the git revision*/
+#define SMP_CACHE_VERSION "1.3"
+
+/*one trace record: issuing processor, operation and byte address*/
+struct TraceRecord
+{
+    ulong proc;
+    uchar op;
+    ulong addr;
+};
+
+/*anything that produces trace records in batches: files, pipes, generators*/
+class TraceSource
+{
+public:
+   virtual ~TraceSource() {}
+   /*writes up to n records into buf, 0 once the source is exhausted*/
+   virtual ulong fill(TraceRecord *buf, ulong n) = 0;
+};
+
+/*everything that determines the outcome of a run*/
+struct SimConfig
+{
+    ulong cache_size;
+    ulong cache_assoc;
+    ulong blk_size;
+    ulong num_processors;
+    ulong protocol;
+    prefetchKind prefetch;
+    ulong prefetchDegree;
+    std::string trace;
+};
+
+/*contention on one line used for synchronization, i.e. touched by an
+  atomic ('a'), load-linked ('l') or store-conditional ('c')*/
+struct LockStats
+{
+    ulong acquires;          /*atomics and successful store-conditionals*/
+    ulong handoffs;          /*acquires by another processor than the last one*/
+    ulong busTransactions;   /*bus requests on the line from any processor*/
+    ulong scFailures;
+    ulong lastProc;
+    LockStats() : acquires(0), handoffs(0), busTransactions(0), scFailures(0), lastProc(ULONG_MAX) {}
+};
+/*keyed by block number*/
+typedef std::unordered_map<ulong, LockStats> lockStatsMap;
+
+/*first record after which a coherence invariant did not hold, with the
+  state of the line in every cache at that point*/
+struct CheckViolation
+{
+    ulong access;                  /*1-based index of the record*/
+    TraceRecord rec;
+    ulong addr;                    /*the failing line, the record's or one it changed too*/
+    const char *invariant;
+    std::vector<ulong> states;     /*per cache, STATE_* of that line*/
+    std::vector<bool> filtered;    /*per cache, snoop filter entry present (MESI Filter)*/
+};
+
+extern const char *protocolName[];
+extern const char *stateName[STATE_MAX];
+extern const ulong numProtocols;
+
+/*0:MSI 1:MSI BusUpgr 2:MESI 3:MESI Snoop Filter 4:Dragon 5:Firefly, NULL if unknown*/
+Cache *createCache(ulong proto, ulong cache_size, ulong cache_assoc, ulong blk_size);
+
+/*The simulation engine: one cache per processor on a snooping bus. Feed it
+  records in order with step() and read the caches' counters in place
+  through getCache(); configure() once and reset() between runs reuses all
+  storage. Nothing here prints, so a tool can embed any number of simulators
+  (one per thread), except that the --profile counters behind PROF_SCOPE
+  (profTicks, profCalls) are process-wide: profile one simulator at a time.
+  A simulator owns its caches and cannot be copied.*/
+class Simulator
+{
+protected:
+   SimConfig config;
+   Cache **cacheArray;
+   ulong numCaches;
+   ulong accesses;
+   ulong badProcs;
+   lockStatsMap lockStats;
+   std::vector<ulong> candidates;   /*prefetch scratch, kept across accesses*/
+
+   double checkRate;
+   ulong nextCheck;                 /*access count of the next checked record*/
+   ulong checkSeed;
+   ulong checks;
+   ulong violations;
+   CheckViolation firstViolation;
+   std::vector<ulong> changedLines; /*other lines the sampled record filled or updated*/
+
+   void freeCaches();
+   void broadcast(ulong proc, ulong addr, busRequestType busReq, bool prefetching,
+                  bool &LineStatus, bool &FlushOptCheck);
+   bool syncAccess(Cache *c, ulong proc, uchar op, ulong addr);
+   void countLockTransaction(Cache *c, ulong addr);
+   void issuePrefetches(ulong proc, ulong addr, bool trigger);
+   void simulate(ulong proc, uchar op, ulong addr);
+   void scheduleCheck();
+   void checkLine(const TraceRecord &rec, ulong addr);
+   void checkRecord(ulong proc, uchar op, ulong addr);
+
+public:
+   Simulator();
+   ~Simulator();
+   Simulator(const Simulator &) = delete;
+   Simulator &operator=(const Simulator &) = delete;
+
+   /*builds the caches (and prefetchers) for config; false for an unknown
+     protocol, no processors, or a geometry that cannot be built: block size,
+     associativity and set count must be nonzero powers of two and the size
+     a multiple of block size * associativity. Reconfiguring with the same
+     geometry only resets.*/
+   bool configure(const SimConfig &config);
+   /*run n records in order*/
+   void step(const TraceRecord *recs, ulong n);
+   /*run one processor request through the requesting cache, broadcast it
+     on the bus to every other cache and apply the post-snoop fix-up.
+     'f' is only counted, 'c' fails without bus traffic when the reservation
+     of the preceding 'l' was lost*/
+   void access(ulong proc, uchar op, ulong addr);
+   /*zero every counter and invalidate every line, keeping all allocations*/
+   void reset();
+
+   /*after a fraction (0 off, 1 every record) of the records, check the
+     accessed line across all caches: single writer/multiple readers, at most
+     one M/E copy, at most one owner (O/Sm) and, with the snoop filter, no
+     filter entry for a line the cache still holds. Records are picked at
+     pseudo-random gaps from a fixed seed, so a run is reproducible.*/
+   void setCheckRate(double rate);
+   ulong getChecks() const              {return checks;}
+   ulong getViolations() const          {return violations;}
+   const CheckViolation &getFirstViolation() const {return firstViolation;}
+
+   const SimConfig &getConfig() const   {return config;}
+   ulong getAccesses() const            {return accesses;}
+   /*records naming a processor that does not exist, skipped*/
+   ulong getBadProcs() const            {return badProcs;}
+   ulong getNumCaches() const           {return numCaches;}
+   Cache *getCache(ulong i) const       {return cacheArray[i];}
+   Cache **getCaches() const            {return cacheArray;}
+   const lockStatsMap &getLockStats() const {return lockStats;}
+};
+
+#endif
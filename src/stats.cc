@@ -0,0 +1,335 @@
+/*******************************************************
+                          stats.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+#include "stats.h"
+using namespace std;
+
+void printConfig(const SimConfig &config)
+{
+    printf("===== 506 Coherence Simulator Configuration =====\n");
+    printf("L1_SIZE: %ld\n", config.cache_size);
+    printf("L1_ASSOC: %ld\n", config.cache_assoc);
+    printf("L1_BLOCKSIZE: %ld\n", config.blk_size);
+    printf("NUMBER OF PROCESSORS: %ld\n", config.num_processors);
+    printf("COHERENCE PROTOCOL: %s\n", protocolName[config.protocol]);
+    printf("TRACE FILE: %s\n", config.trace.c_str());
+}
+
+/*trace names are paths or generator specs, escape what json cannot hold*/
+static void printJSONString(FILE *out, const string &s)
+{
+    fputc('"', out);
+    for(size_t i = 0; i < s.size(); i++) {
+        uchar c = s[i];
+        if(c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if(c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static const ulong LOCK_REPORT_LINES = 10;
+
+static bool moreHandoffs(const pair<ulong, LockStats> &a, const pair<ulong, LockStats> &b)
+{
+    if(a.second.handoffs != b.second.handoffs) return a.second.handoffs > b.second.handoffs;
+    return a.first < b.first;
+}
+
+/*the most contended lock lines, by handoffs between processors*/
+static void topLocks(const lockStatsMap &lockStats, vector<pair<ulong, LockStats> > &top)
+{
+    top.assign(lockStats.begin(), lockStats.end());
+    ulong n = min((ulong)top.size(), LOCK_REPORT_LINES);
+    partial_sort(top.begin(), top.begin() + n, top.end(), moreHandoffs);
+    top.resize(n);
+}
+
+static void printStatsJSON(FILE *out, const SimConfig &config, Cache **cacheArray, ulong num_processors,
+                           const lockStatsMap &lockStats)
+{
+    fprintf(out, "{\n  \"version\": \"%s\",\n", SMP_CACHE_VERSION);
+    fprintf(out, "  \"config\": {\"cache_size\": %lu, \"assoc\": %lu, \"block_size\": %lu, "
+                 "\"processors\": %lu, \"protocol\": \"%s\", \"trace\": ",
+            config.cache_size, config.cache_assoc, config.blk_size,
+            config.num_processors, protocolName[config.protocol]);
+    printJSONString(out, config.trace);
+    fprintf(out, "},\n  \"caches\": [\n");
+    for(ulong i = 0; i < num_processors; i++) {
+        counterList counters;
+        rateList rates;
+        cacheArray[i]->getCounters(counters);
+        cacheArray[i]->getRates(rates);
+        fprintf(out, "    {\"cache\": %lu", i);
+        for(ulong j = 0; j < counters.size(); j++) {
+            fprintf(out, ", \"%s\": %lu", counters[j].first, counters[j].second);
+        }
+        for(ulong j = 0; j < rates.size(); j++) {
+            fprintf(out, ", \"%s\": %.6g", rates[j].first, rates[j].second);
+        }
+        fprintf(out, "}%s\n", (i + 1 < num_processors) ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"lock_lines\": %lu,\n  \"locks\": [", (ulong)lockStats.size());
+    vector<pair<ulong, LockStats> > top;
+    topLocks(lockStats, top);
+    for(ulong i = 0; i < top.size(); i++) {
+        const LockStats &ls = top[i].second;
+        fprintf(out, "%s\n    {\"block_addr\": %lu, \"acquires\": %lu, \"handoffs\": %lu, "
+                     "\"bus_transactions\": %lu, \"sc_failures\": %lu}",
+                i ? "," : "", top[i].first * config.blk_size, ls.acquires, ls.handoffs,
+                ls.busTransactions, ls.scFailures);
+    }
+    fprintf(out, "%s]\n}\n", top.empty() ? "" : "\n  ");
+}
+
+static void printStatsCSV(FILE *out, Cache **cacheArray, ulong num_processors)
+{
+    for(ulong i = 0; i < num_processors; i++) {
+        counterList counters;
+        rateList rates;
+        cacheArray[i]->getCounters(counters);
+        cacheArray[i]->getRates(rates);
+        if(i == 0) {
+            fprintf(out, "cache");
+            for(ulong j = 0; j < counters.size(); j++) fprintf(out, ",%s", counters[j].first);
+            for(ulong j = 0; j < rates.size(); j++) fprintf(out, ",%s", rates[j].first);
+            fprintf(out, "\n");
+        }
+        fprintf(out, "%lu", i);
+        for(ulong j = 0; j < counters.size(); j++) fprintf(out, ",%lu", counters[j].second);
+        for(ulong j = 0; j < rates.size(); j++) fprintf(out, ",%.6g", rates[j].second);
+        fprintf(out, "\n");
+    }
+}
+
+void printAllStats(FILE *out, statsFormat format, const Simulator &sim)
+{
+    const SimConfig &config = sim.getConfig();
+    Cache **cacheArray = sim.getCaches();
+    ulong num_processors = sim.getNumCaches();
+    const lockStatsMap &lockStats = sim.getLockStats();
+
+    if(format == STATS_JSON) {
+        printStatsJSON(out, config, cacheArray, num_processors, lockStats);
+        return;
+    }
+    if(format == STATS_CSV) {
+        printStatsCSV(out, cacheArray, num_processors);
+        return;
+    }
+
+    //********************************//
+    //print out all caches' statistics //
+    //********************************//
+    for(int i=0;i<(int)num_processors;i++) {
+        fprintf(out, "============ Simulation results (Cache %d) ============\n",i);
+        cacheArray[i]->printStats(out);
+        if(config.protocol == 3)
+        {
+            fprintf(out, "14. number of useful snoops: %lu\n", ((MESI_Snoop_Filter_Cache *)cacheArray[i])->ct_snoop_filter_useful);
+            fprintf(out, "15. number of wasted snoops: %lu\n", ((MESI_Snoop_Filter_Cache *)cacheArray[i])->ct_snoop_filter_wasted);
+            fprintf(out, "16. number of filtered snoops: %lu\n", ((MESI_Snoop_Filter_Cache *)cacheArray[i])->ct_snoop_filter_filtered);
+        }
+        if(config.protocol == 4 || config.protocol == 5)
+        {
+            ((Update_Cache *)cacheArray[i])->printUpdateStats(out);
+        }
+        if(cacheArray[i]->prefetcher != NULL)
+        {
+            cacheArray[i]->printPrefetchStats(out);
+        }
+        if(cacheArray[i]->sawSyncOps())
+        {
+            cacheArray[i]->printSyncStats(out);
+        }
+    }
+    if(!lockStats.empty())
+    {
+        vector<pair<ulong, LockStats> > top;
+        topLocks(lockStats, top);
+        fprintf(out, "============ Lock contention (top %lu of %lu lines by handoffs) ============\n",
+                (ulong)top.size(), (ulong)lockStats.size());
+        for(ulong i = 0; i < top.size(); i++) {
+            const LockStats &ls = top[i].second;
+            fprintf(out, "0x%lx: acquires %lu, handoffs %lu, bus transactions %lu, sc failures %lu\n",
+                    top[i].first * config.blk_size, ls.acquires, ls.handoffs,
+                    ls.busTransactions, ls.scFailures);
+        }
+    }
+}
+
+void printCheckReport(FILE *out, const Simulator &sim)
+{
+    fprintf(out, "invariant check: %lu records checked, %lu violations\n",
+            sim.getChecks(), sim.getViolations());
+    if(sim.getViolations() == 0) {
+        return;
+    }
+    const CheckViolation &v = sim.getFirstViolation();
+    const SimConfig &config = sim.getConfig();
+    fprintf(out, "first violation: %s\n", v.invariant);
+    fprintf(out, "  after record %lu: %lu %c %lx (block 0x%lx%s, protocol %s)\n", v.access,
+            v.rec.proc, v.rec.op, v.rec.addr, v.addr & ~(config.blk_size - 1),
+            (v.addr ^ v.rec.addr) & ~(config.blk_size - 1) ? ", changed by the record" : "",
+            protocolName[config.protocol]);
+    for(ulong i = 0; i < v.states.size(); i++) {
+        fprintf(out, "  cache %lu: %s%s\n", i, stateName[v.states[i]],
+                v.filtered[i] ? " (snoop filter entry)" : "");
+    }
+}
+
+void printProgress(FILE *out, Cache **cacheArray, ulong num_processors,
+                   ulong accesses, double secs)
+{
+    counterList total, counters;
+    cacheArray[0]->getCounters(total);
+    for(ulong i = 1; i < num_processors; i++) {
+        counters.clear();
+        cacheArray[i]->getCounters(counters);
+        for(ulong j = 0; j < total.size(); j++) {
+            total[j].second += counters[j].second;
+        }
+    }
+    fprintf(out, "progress: %lu accesses %.1fs %.0f/s", accesses, secs, secs > 0 ? accesses / secs : 0.0);
+    for(ulong j = 0; j < total.size(); j++) {
+        fprintf(out, " %s=%lu", total[j].first, total[j].second);
+    }
+    fprintf(out, "\n");
+    fflush(out);
+}
+
+// samples queued ahead of the writer before sample() blocks, bounds the
+// memory when the file or pipe is slower than the simulation
+static const ulong INTERVAL_QUEUE_ROWS = 4096;
+
+IntervalWriter::IntervalWriter()
+{
+    out = NULL;
+    cacheArray = NULL;
+    numCaches = 0;
+    done = false;
+    interval = 0;
+    nextSample = ULONG_MAX;
+}
+
+IntervalWriter::~IntervalWriter()
+{
+    if(out != NULL) {
+        close(ULONG_MAX);
+    }
+}
+
+bool IntervalWriter::open(const char *fname, ulong every, Cache **caches, ulong num_processors)
+{
+    if(every == 0) {
+        return false;
+    }
+    out = fopen(fname, "w");
+    if(out == NULL) {
+        return false;
+    }
+    cacheArray = caches;
+    numCaches = num_processors;
+    interval = every;
+    nextSample = every;
+
+    scratch.clear();
+    cacheArray[0]->getCounters(scratch);
+    fprintf(out, "access,cache");
+    for(ulong j = 0; j < scratch.size(); j++) {
+        fprintf(out, ",%s", scratch[j].first);
+    }
+    fprintf(out, "\n");
+    last.assign(scratch.size() * numCaches, 0);
+
+    done = false;
+    writer = thread(&IntervalWriter::writerLoop, this);
+    return true;
+}
+
+void IntervalWriter::sample(ulong accesses)
+{
+    vector<ulong> row;
+    {
+        lock_guard<mutex> guard(lock);
+        if(!spare.empty()) {
+            row.swap(spare.back());
+            spare.pop_back();
+        }
+    }
+    row.clear();
+    row.push_back(accesses);
+    ulong k = 0;
+    for(ulong i = 0; i < numCaches; i++) {
+        scratch.clear();
+        cacheArray[i]->getCounters(scratch);
+        for(ulong j = 0; j < scratch.size(); j++, k++) {
+            row.push_back(scratch[j].second - last[k]);
+            last[k] = scratch[j].second;
+        }
+    }
+    {
+        unique_lock<mutex> guard(lock);
+        drained.wait(guard, [this] { return pending.size() < INTERVAL_QUEUE_ROWS; });
+        pending.push_back(vector<ulong>());
+        pending.back().swap(row);
+    }
+    ready.notify_one();
+    nextSample = accesses + interval;
+}
+
+void IntervalWriter::writerLoop()
+{
+    unique_lock<mutex> guard(lock);
+    while(true) {
+        ready.wait(guard, [this] { return done || !pending.empty(); });
+        if(pending.empty()) {
+            break;
+        }
+        vector<ulong> row;
+        row.swap(pending.front());
+        pending.pop_front();
+        guard.unlock();
+        drained.notify_one();
+
+        ulong perCache = (row.size() - 1) / numCaches;
+        for(ulong i = 0; i < numCaches; i++) {
+            fprintf(out, "%lu,%lu", row[0], i);
+            for(ulong j = 0; j < perCache; j++) {
+                fprintf(out, ",%lu", row[1 + i * perCache + j]);
+            }
+            fprintf(out, "\n");
+        }
+
+        guard.lock();
+        spare.push_back(vector<ulong>());
+        spare.back().swap(row);
+    }
+}
+
+void IntervalWriter::close(ulong accesses)
+{
+    if(out == NULL) {
+        return;
+    }
+    if(accesses != ULONG_MAX && accesses + interval != nextSample) {
+        sample(accesses);
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        done = true;
+    }
+    ready.notify_one();
+    writer.join();
+    fclose(out);
+    out = NULL;
+    nextSample = ULONG_MAX;
+}
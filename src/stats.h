@@ -0,0 +1,67 @@
+/*******************************************************
+                          stats.h
+********************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "sim.h"
+
+enum statsFormat {
+    STATS_TEXT = 0,
+    STATS_JSON,
+    STATS_CSV
+};
+
+/*configuration banner of the human-readable report*/
+void printConfig(const SimConfig &config);
+/*final report of every cache in the requested format*/
+void printAllStats(FILE *out, statsFormat format, const Simulator &sim);
+/*summary of the invariant checker and the first violation, if any*/
+void printCheckReport(FILE *out, const Simulator &sim);
+/*one line of running totals over all caches, for long or live runs*/
+void printProgress(FILE *out, Cache **cacheArray, ulong num_processors,
+                   ulong accesses, double secs);
+
+/*Writes per-cache counter deltas every `interval` accesses as csv rows
+  "access,cache,<counter>..." . sample() only snapshots the counters and
+  queues them, a background thread formats and writes the rows so that the
+  simulation loop only waits on the file once the queue is full.*/
+class IntervalWriter
+{
+protected:
+   FILE *out;
+   Cache **cacheArray;
+   ulong numCaches;
+   std::vector<ulong> last;          /*counters at the previous sample*/
+   counterList scratch;
+
+   std::thread writer;
+   std::mutex lock;
+   std::condition_variable ready;
+   std::condition_variable drained;  /*the writer took a row off a full queue*/
+   std::deque<std::vector<ulong> > pending;
+   std::vector<std::vector<ulong> > spare;  /*recycled row buffers*/
+   bool done;
+
+   void writerLoop();
+
+public:
+   ulong interval;
+   ulong nextSample;
+
+   IntervalWriter();
+   ~IntervalWriter();
+   bool open(const char *fname, ulong every, Cache **caches, ulong num_processors);
+   void sample(ulong accesses);
+   /*queues the last partial interval and waits for the writer to drain*/
+   void close(ulong accesses);
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*******************************************************
+                          trace.cc
+********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "trace.h"
+using namespace std;
+
+TraceReader::TraceReader(ulong bufferBytes)
+{
+    fd = -1;
+    bufSize = bufferBytes;
+    buf = new char[bufSize];
+    pos = end = 0;
+    eof = true;
+    badRecords = 0;
+}
+
+TraceReader::~TraceReader()
+{
+    close();
+    delete [] buf;
+}
+
+bool TraceReader::open(const char *fname)
+{
+    close();
+    if(strcmp(fname, "-") == 0) {
+        fd = 0;
+    } else {
+        fd = ::open(fname, O_RDONLY);
+        if(fd < 0) {
+            return false;
+        }
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    pos = end = 0;
+    eof = false;
+    badRecords = 0;
+    return true;
+}
+
+void TraceReader::close()
+{
+    if(fd > 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    eof = true;
+}
+
+/*keep the unparsed tail, append the next block; false at EOF, on error or
+  when a signal interrupted the read*/
+bool TraceReader::refill()
+{
+    if(pos > 0) {
+        memmove(buf, buf + pos, end - pos);
+        end -= pos;
+        pos = 0;
+    }
+    if(end == bufSize) {
+        /*a "line" longer than the whole buffer cannot be a record*/
+        badRecords++;
+        end = 0;
+    }
+    ssize_t got = read(fd, buf + end, bufSize - end);
+    if(got < 0 && errno == EINTR) {
+        return false;
+    }
+    if(got <= 0) {
+        eof = true;
+        return false;
+    }
+    end += got;
+    return true;
+}
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline int hexValue(char c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*"<op char> <hex addr>" after the leading field, optional 0x prefix on the address,
+  which a fence may leave out*/
+bool TraceReader::parseOpAddr(const char *p, const char *lineEnd, TraceRecord &rec)
+{
+    while(p < lineEnd && isBlank(*p)) p++;
+    if(p == lineEnd) return false;
+    rec.op = *p++;
+    while(p < lineEnd && isBlank(*p)) p++;
+    if(lineEnd - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+
+    ulong addr = 0;
+    int v;
+    const char *digits = p;
+    while(p < lineEnd && (v = hexValue(*p)) >= 0) {
+        addr = (addr << 4) | v;
+        p++;
+    }
+    if(p == digits && rec.op != 'f') return false;
+    rec.addr = addr;
+    return true;
+}
+
+/*leading decimal field: the processor, or the timestamp of a per-core file*/
+static inline const char *parseDecimal(const char *p, const char *lineEnd, ulong &value)
+{
+    value = 0;
+    while(p < lineEnd && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    return p;
+}
+
+/*"<decimal proc> <op char> <hex addr>"*/
+bool TraceReader::parseLine(const char *p, const char *lineEnd, TraceRecord &rec)
+{
+    while(p < lineEnd && isBlank(*p)) p++;
+    if(p == lineEnd) return false;
+
+    ulong proc;
+    const char *digits = p;
+    p = parseDecimal(p, lineEnd, proc);
+    if(p == digits || !parseOpAddr(p, lineEnd, rec)) {
+        badRecords++;
+        return false;
+    }
+    rec.proc = proc;
+    return true;
+}
+
+/*"[<decimal timestamp>] <op char> <hex addr>", ops are letters so a leading
+  digit means the record is timestamped*/
+bool TraceReader::parseCoreLine(const char *p, const char *lineEnd, TraceRecord &rec,
+                                ulong &stamp, bool &timed)
+{
+    while(p < lineEnd && isBlank(*p)) p++;
+    if(p == lineEnd) return false;
+
+    timed = (*p >= '0' && *p <= '9');
+    stamp = 0;
+    if(timed) {
+        p = parseDecimal(p, lineEnd, stamp);
+    }
+    if(!parseOpAddr(p, lineEnd, rec)) {
+        badRecords++;
+        return false;
+    }
+    return true;
+}
+
+/*next line as [start, lineEnd), valid until the following call; false at
+  the end of the input or when a signal interrupted the read*/
+bool TraceReader::nextLine(const char *&start, const char *&lineEnd)
+{
+    for(;;) {
+        char *s = buf + pos;
+        char *nl = (char *)memchr(s, '\n', end - pos);
+        if(nl == NULL) {
+            if(!eof) {
+                if(refill()) continue;
+                if(!eof) return false;  /*interrupted, hand back what we have*/
+            }
+            if(pos == end) return false;
+            nl = buf + end;             /*last line has no newline*/
+        }
+        start = s;
+        lineEnd = nl;
+        pos = (nl - buf) + ((nl < buf + end) ? 1 : 0);
+        return true;
+    }
+}
+
+ulong TraceReader::fill(TraceRecord *recs, ulong n)
+{
+    ulong got = 0;
+    const char *start, *lineEnd;
+    while(got < n && nextLine(start, lineEnd)) {
+        if(parseLine(start, lineEnd, recs[got])) {
+            got++;
+        }
+    }
+    return got;
+}
+
+bool TraceReader::nextCoreRecord(ulong core, TraceRecord &rec, ulong &stamp, bool &timed)
+{
+    const char *start, *lineEnd;
+    while(nextLine(start, lineEnd)) {
+        if(parseCoreLine(start, lineEnd, rec, stamp, timed)) {
+            rec.proc = core;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,46 @@
+/*******************************************************
+                          trace.h
+********************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "sim.h"
+
+/*Reads "proc op addr" text records (addr in hex) from a file, a named pipe
+  or stdin ("-") with large block reads into a fixed buffer, so memory use
+  does not depend on the trace length and the input need not be seekable.
+  Lines that do not parse are skipped and counted.*/
+class TraceReader: public TraceSource
+{
+protected:
+   int fd;
+   char *buf;
+   ulong bufSize;
+   ulong pos, end;     /*unparsed bytes are buf[pos..end)*/
+   bool eof;
+
+   bool refill();
+   bool nextLine(const char *&start, const char *&lineEnd);
+   bool parseOpAddr(const char *p, const char *lineEnd, TraceRecord &rec);
+   bool parseLine(const char *p, const char *lineEnd, TraceRecord &rec);
+   bool parseCoreLine(const char *p, const char *lineEnd, TraceRecord &rec,
+                      ulong &stamp, bool &timed);
+
+public:
+   ulong badRecords;
+
+   TraceReader(ulong bufferBytes = 1 << 20);
+   ~TraceReader();
+   bool open(const char *fname);
+   void close();
+   ulong fill(TraceRecord *recs, ulong n);
+
+   /*true once every byte of the input has been consumed*/
+   bool finished()   {return eof && pos == end;}
+   /*one record of a per-core file, "[<decimal timestamp>] <op> <hex addr>";
+     the processor is `core`. false at the end or when interrupted.*/
+   bool nextCoreRecord(ulong core, TraceRecord &rec, ulong &stamp, bool &timed);
+};
+
+#endif